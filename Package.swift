@@ -7,6 +7,8 @@ var sources = ["src/parser.c"]
 if FileManager.default.fileExists(atPath: "src/scanner.c") {
     sources.append("src/scanner.c")
 }
+// the rest of what the C header declares
+sources += ["src/outline.c", "src/sections.c", "src/parallel.c", "src/input.c", "src/section_table.c"]
 
 let package = Package(
     name: "TreeSitterOrgmode",
@@ -26,7 +28,8 @@ let package = Package(
                 .copy("queries")
             ],
             publicHeadersPath: "bindings/swift",
-            cSettings: [.headerSearchPath("src")]
+            cSettings: [.headerSearchPath("src")],
+            linkerSettings: [.linkedLibrary("pthread", .when(platforms: [.linux]))]
         ),
         .testTarget(
             name: "TreeSitterOrgmodeTests",
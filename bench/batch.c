@@ -0,0 +1,375 @@
+// Parses every org file under some paths on a pool of threads, as fast as
+// they'll go.
+//
+// Directories are walked by the pool too: a thread that lists a directory
+// pushes what's in it onto the pool's stack of tasks, and a thread with
+// nothing to do sleeps until there's more, or until there's nothing left
+// that could make more. The threads are tree_sitter_orgmode_run_parallel's,
+// each keeps one parser for every file it parses, and files are mapped into
+// memory by tree_sitter_orgmode_mapped_file_open rather than read.
+//
+// Every file reports one JSON object per line with its size, parse time,
+// error and missing nodes, and headings, and the last line has the totals
+// and the throughput over the wall clock time. Run with -j 1, 2, 4, ... it
+// shows how parsing scales with cores.
+//
+//     orgmode-batch [-j threads] [-q] path...
+//
+// Directories are searched for *.org files; files named directly are parsed
+// whatever they're called. -j sets the number of threads (default one for
+// each CPU) and -q leaves out the lines for each file. The exit status is 1
+// if a file couldn't be read or parsed.
+
+#define _DEFAULT_SOURCE
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-orgmode.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    char *path;
+    bool is_dir;
+} Task;
+
+typedef struct {
+    uint64_t files;
+    uint64_t bytes;
+    uint64_t parse_ns;
+    uint64_t error_files;
+    uint64_t errors;
+    uint64_t headings;
+    uint64_t failures; // couldn't be read or parsed
+    uint64_t waits; // times the thread had nothing to do
+} Totals;
+
+typedef struct Pool Pool;
+
+typedef struct {
+    Pool *pool;
+    unsigned index;
+    TSParser *parser;
+    Totals totals;
+} Worker;
+
+struct Pool {
+    Worker *workers;
+    bool quiet;
+    // tasks waiting, taken from the back, so the threads work depth first
+    // through what was found last
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    Task *tasks;
+    uint32_t task_count;
+    uint32_t task_capacity;
+    // tasks pushed and not yet finished. when it's 0 there's nothing left
+    // that could make more.
+    uint64_t pending;
+    pthread_mutex_t output;
+    TSSymbol section;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static void *checked_alloc(void *ptr) {
+    if (ptr == NULL) {
+        perror("orgmode-batch");
+        exit(1);
+    }
+    return ptr;
+}
+
+static void push_task(Pool *pool, char *path, bool is_dir) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->task_count == pool->task_capacity) {
+        pool->task_capacity = pool->task_capacity < 64 ? 64 : pool->task_capacity * 2;
+        pool->tasks = checked_alloc(realloc(pool->tasks, pool->task_capacity * sizeof(Task)));
+    }
+    pool->tasks[pool->task_count++] = (Task) {path, is_dir};
+    pool->pending++;
+    pthread_cond_signal(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static bool next_task(Worker *w, Task *task) {
+    Pool *pool = w->pool;
+    pthread_mutex_lock(&pool->lock);
+    // a task still running can push more, so wait for it rather than give up
+    while (pool->task_count == 0 && pool->pending > 0) {
+        w->totals.waits++;
+        pthread_cond_wait(&pool->ready, &pool->lock);
+    }
+    bool found = pool->task_count > 0;
+    if (found) *task = pool->tasks[--pool->task_count];
+    pthread_mutex_unlock(&pool->lock);
+    return found;
+}
+
+// only once the task's children have been pushed, so that pending can't
+// reach 0 while there's more to come
+static void finish_task(Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->pending == 0) pthread_cond_broadcast(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static bool has_org_extension(const char *name) {
+    size_t length = strlen(name);
+    return length > 4 && strcmp(name + length - 4, ".org") == 0;
+}
+
+static char *join_path(const char *dir, const char *name) {
+    size_t dir_length = strlen(dir);
+    size_t name_length = strlen(name);
+    char *path = checked_alloc(malloc(dir_length + name_length + 2));
+    memcpy(path, dir, dir_length);
+    path[dir_length] = '/';
+    memcpy(path + dir_length + 1, name, name_length + 1);
+    return path;
+}
+
+static void report_failure(Worker *w, const char *path, const char *what) {
+    w->totals.failures++;
+    pthread_mutex_lock(&w->pool->output);
+    fprintf(stderr, "orgmode-batch: %s: %s\n", path, what);
+    pthread_mutex_unlock(&w->pool->output);
+}
+
+static void walk_dir(Worker *w, const char *path) {
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        report_failure(w, path, strerror(errno));
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+        bool is_dir = entry->d_type == DT_DIR;
+        bool is_file = entry->d_type == DT_REG;
+        char *child = join_path(path, name);
+
+        // symlinks are followed to files, but not to directories, so a
+        // link can't lead round in a loop
+        if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+            struct stat st;
+            if (stat(child, &st) == 0) {
+                is_dir = entry->d_type == DT_UNKNOWN && S_ISDIR(st.st_mode);
+                is_file = S_ISREG(st.st_mode);
+            }
+        }
+
+        if (is_dir || (is_file && has_org_extension(name))) {
+            push_task(w->pool, child, is_dir);
+        } else {
+            free(child);
+        }
+    }
+
+    closedir(dir);
+}
+
+// errors and missing nodes, looking only inside nodes which have some
+static uint64_t count_errors(TSNode node) {
+    if (ts_node_is_missing(node)) return 1;
+    if (!ts_node_has_error(node)) return 0;
+    uint64_t count = strcmp(ts_node_type(node), "ERROR") == 0;
+    for (uint32_t i = 0, n = ts_node_child_count(node); i < n; i++) {
+        count += count_errors(ts_node_child(node, i));
+    }
+    return count;
+}
+
+// headings are only ever in sections, which are only in the document and
+// other sections, so the rest of the tree is never looked at
+static uint64_t count_headings(TSNode node, TSSymbol section) {
+    uint64_t count = 0;
+    for (uint32_t i = 0, n = ts_node_child_count(node); i < n; i++) {
+        TSNode child = ts_node_child(node, i);
+        if (ts_node_symbol(child) == section) count += 1 + count_headings(child, section);
+    }
+    return count;
+}
+
+static void parse_file(Worker *w, const char *path) {
+    TSOrgmodeMappedFile file;
+    if (!tree_sitter_orgmode_mapped_file_open(&file, path)) {
+        report_failure(w, path, strerror(errno));
+        return;
+    }
+    if (file.size > UINT32_MAX) {
+        report_failure(w, path, "too big to parse");
+        tree_sitter_orgmode_mapped_file_close(&file);
+        return;
+    }
+
+    size_t size = file.size;
+    const char *text = file.data != NULL ? file.data : "";
+
+    uint64_t start = now_ns();
+    TSTree *tree = ts_parser_parse_string(w->parser, NULL, text, (uint32_t) size);
+    uint64_t elapsed = now_ns() - start;
+
+    if (tree == NULL) {
+        report_failure(w, path, "parse failed");
+    } else {
+        TSNode root = ts_tree_root_node(tree);
+        uint64_t errors = count_errors(root);
+        uint64_t headings = count_headings(root, w->pool->section);
+
+        w->totals.files++;
+        w->totals.bytes += size;
+        w->totals.parse_ns += elapsed;
+        w->totals.errors += errors;
+        w->totals.error_files += errors > 0;
+        w->totals.headings += headings;
+
+        if (!w->pool->quiet) {
+            pthread_mutex_lock(&w->pool->output);
+            printf("{\"path\":\"");
+            for (const char *p = path; *p != '\0'; p++) {
+                if (*p == '"' || *p == '\\') putchar('\\');
+                if ((unsigned char) *p < 0x20) printf("\\u%04x", *p);
+                else putchar(*p);
+            }
+            printf("\",\"bytes\":%zu,\"parse_ns\":%llu,\"errors\":%llu,\"headings\":%llu,\"thread\":%u}\n",
+                   size, (unsigned long long) elapsed, (unsigned long long) errors,
+                   (unsigned long long) headings, w->index);
+            pthread_mutex_unlock(&w->pool->output);
+        }
+        ts_tree_delete(tree);
+    }
+
+    tree_sitter_orgmode_mapped_file_close(&file);
+}
+
+// run once on each of the pool's threads, taking tasks until there are none
+// left and none running
+static void run_worker(void *context, unsigned worker, uint32_t item) {
+    (void) item;
+    Worker *w = &((Pool *) context)->workers[worker];
+    Task task;
+    while (next_task(w, &task)) {
+        if (task.is_dir) walk_dir(w, task.path);
+        else parse_file(w, task.path);
+        free(task.path);
+        finish_task(w->pool);
+    }
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [-j threads] [-q] path...\n", program);
+}
+
+int main(int argc, char **argv) {
+    unsigned threads = tree_sitter_orgmode_cpu_count();
+    bool quiet = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:q")) != -1) {
+        switch (opt) {
+            case 'j':
+                threads = (unsigned) strtoul(optarg, NULL, 10);
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (threads == 0 || optind == argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const TSLanguage *language = tree_sitter_orgmode();
+    Pool pool = {.quiet = quiet};
+    pool.section = ts_language_symbol_for_name(language, "section", (uint32_t) strlen("section"), true);
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.ready, NULL);
+    pthread_mutex_init(&pool.output, NULL);
+    pool.workers = checked_alloc(calloc(threads, sizeof(Worker)));
+
+    for (unsigned i = 0; i < threads; i++) {
+        Worker *w = &pool.workers[i];
+        w->pool = &pool;
+        w->index = i;
+        w->parser = ts_parser_new();
+        if (!ts_parser_set_language(w->parser, language)) {
+            fprintf(stderr, "orgmode-batch: incompatible language version\n");
+            return 1;
+        }
+    }
+
+    uint64_t failures = 0;
+    for (int i = optind; i < argc; i++) {
+        struct stat st;
+        if (stat(argv[i], &st) != 0) {
+            fprintf(stderr, "orgmode-batch: %s: %s\n", argv[i], strerror(errno));
+            failures++;
+            continue;
+        }
+        push_task(&pool, checked_alloc(strdup(argv[i])), S_ISDIR(st.st_mode));
+    }
+
+    // one long running item for each thread, which between them take every
+    // task; if a thread can't be started the others take its share
+    uint64_t start = now_ns();
+    if (!tree_sitter_orgmode_run_parallel(threads, threads, run_worker, &pool)) {
+        perror("orgmode-batch");
+        return 1;
+    }
+    uint64_t wall_ns = now_ns() - start;
+
+    Totals totals = {.failures = failures};
+    for (unsigned i = 0; i < threads; i++) {
+        Totals *t = &pool.workers[i].totals;
+        totals.files += t->files;
+        totals.bytes += t->bytes;
+        totals.parse_ns += t->parse_ns;
+        totals.error_files += t->error_files;
+        totals.errors += t->errors;
+        totals.headings += t->headings;
+        totals.failures += t->failures;
+        totals.waits += t->waits;
+
+        ts_parser_delete(pool.workers[i].parser);
+    }
+
+    printf("{\"threads\":%u,\"files\":%llu,\"bytes\":%llu,\"failures\":%llu,\"error_files\":%llu,"
+           "\"errors\":%llu,\"headings\":%llu,\"waits\":%llu,\"wall_ns\":%llu,\"parse_ns\":%llu,"
+           "\"mb_per_s\":%.1f,\"files_per_s\":%.1f}\n",
+           threads, (unsigned long long) totals.files, (unsigned long long) totals.bytes,
+           (unsigned long long) totals.failures, (unsigned long long) totals.error_files,
+           (unsigned long long) totals.errors, (unsigned long long) totals.headings,
+           (unsigned long long) totals.waits, (unsigned long long) wall_ns,
+           (unsigned long long) totals.parse_ns,
+           wall_ns > 0 ? totals.bytes * 1e3 / wall_ns : 0.0,
+           wall_ns > 0 ? totals.files * 1e9 / wall_ns : 0.0);
+
+    free(pool.tasks);
+    free(pool.workers);
+    pthread_cond_destroy(&pool.ready);
+    pthread_mutex_destroy(&pool.lock);
+    pthread_mutex_destroy(&pool.output);
+    return totals.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,381 @@
+#include "corpus.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KiB ((size_t) 1024)
+#define MiB (1024 * KiB)
+
+#define MAX_HEADING_DEPTH 24
+#define MAX_LIST_DEPTH 8
+
+// splitmix64, which is all we need and gives the same stream everywhere
+static uint64_t next_random(uint64_t *rng) {
+    uint64_t z = (*rng += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static unsigned below(uint64_t *rng, unsigned n) {
+    return (unsigned) (next_random(rng) % n);
+}
+
+static bool one_in(uint64_t *rng, unsigned n) {
+    return below(rng, n) == 0;
+}
+
+#define PICK(rng, list) (list[below(rng, sizeof(list) / sizeof(list[0]))])
+
+static const char *const words[] = {
+    "the", "a", "of", "to", "and", "in", "notes", "parser", "tree", "node",
+    "heading", "outline", "agenda", "meeting", "draft", "review", "release",
+    "index", "query", "scanner", "buffer", "edit", "latency", "throughput",
+    "fleet", "shard", "worker", "archive", "project", "deadline", "schedule",
+    "idea", "question", "answer", "summary", "reference", "paper", "chapter",
+    "refactor", "benchmark", "profile", "memory", "allocation", "cache",
+    "write", "read", "check", "update", "move", "merge", "split", "plan",
+    "quickly", "slowly", "really", "maybe", "later", "today", "tomorrow",
+    "résumé", "naïve", "über", "café",
+};
+
+static const char *const todo_keywords[] = {"TODO", "NEXT", "WAIT", "DONE"};
+static const char *const tags[] = {"work", "home", "reading", "emacs", "project", "urgent"};
+static const char *const languages[] = {"c", "python", "rust", "emacs-lisp", "sh", "js"};
+static const char *const property_names[] = {
+    "CUSTOM_ID", "ID", "CREATED", "CATEGORY", "EFFORT", "ORDERED", "STYLE",
+    "LAST_REPEAT", "ARCHIVE_TIME", "header-args+",
+};
+static const char *const days[] = {"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun"};
+
+// source lines full of the characters that would start markup, drawers,
+// keywords or lists anywhere else
+static const char *const code_lines[] = {
+    "int *p = &values[i * stride + offset];",
+    "total = (a * b) / (c - d) + e_f;",
+    "if x == y and not z: return [x, y]",
+    "let v: Vec<_> = xs.iter().map(|x| x * 2).collect();",
+    "(setq org-agenda-files '(\"~/org/\"))",
+    "for f in *.org; do grep -n ':END:' \"$f\"; done",
+    "# a shell comment, #+not a keyword",
+    "- not a list item, just an argument",
+    "* not a heading either",
+    "const re = /[a-z]+_[0-9]*/g; // ~approx~",
+    ":not-a-drawer:",
+    "x += 1; y -= 2; z = ~mask & 0xff;",
+    "",
+};
+
+static void corpus_reserve(Corpus *corpus, size_t extra) {
+    if (corpus->size + extra <= corpus->capacity) return;
+
+    size_t capacity = corpus->capacity == 0 ? 64 * KiB : corpus->capacity;
+    while (capacity < corpus->size + extra) capacity *= 2;
+
+    char *contents = realloc(corpus->contents, capacity);
+    if (contents == NULL) {
+        fprintf(stderr, "out of memory generating a %zu byte corpus\n", capacity);
+        abort();
+    }
+
+    corpus->contents = contents;
+    corpus->capacity = capacity;
+}
+
+static void put_bytes(Corpus *corpus, const char *bytes, size_t size) {
+    corpus_reserve(corpus, size);
+    memcpy(corpus->contents + corpus->size, bytes, size);
+    corpus->size += size;
+}
+
+static void put_str(Corpus *corpus, const char *str) {
+    put_bytes(corpus, str, strlen(str));
+}
+
+static void put_char(Corpus *corpus, char c, unsigned count) {
+    corpus_reserve(corpus, count);
+    memset(corpus->contents + corpus->size, c, count);
+    corpus->size += count;
+}
+
+static void put_format(Corpus *corpus, const char *format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    put_bytes(corpus, buffer, (size_t) length < sizeof(buffer) ? (size_t) length : sizeof(buffer) - 1);
+}
+
+static void put_words(Corpus *corpus, uint64_t *rng, unsigned count) {
+    for (unsigned i = 0; i < count; i++) {
+        if (i > 0) put_char(corpus, ' ', 1);
+        put_str(corpus, PICK(rng, words));
+    }
+}
+
+static void put_timestamp(Corpus *corpus, uint64_t *rng, char open, char close) {
+    put_format(corpus, "%c20%02u-%02u-%02u %s %02u:%02u%c",
+               open, 10 + below(rng, 20), 1 + below(rng, 12), 1 + below(rng, 28),
+               PICK(rng, days), below(rng, 24), below(rng, 60), close);
+}
+
+static void put_heading(Corpus *corpus, uint64_t *rng, unsigned level) {
+    put_char(corpus, '*', level);
+    put_char(corpus, ' ', 1);
+    if (one_in(rng, 3)) {
+        put_str(corpus, PICK(rng, todo_keywords));
+        put_char(corpus, ' ', 1);
+    }
+    put_words(corpus, rng, 2 + below(rng, 6));
+    if (one_in(rng, 4)) {
+        put_str(corpus, " :");
+        put_str(corpus, PICK(rng, tags));
+        put_char(corpus, ':', 1);
+    }
+    put_char(corpus, '\n', 1);
+}
+
+static void put_paragraph(Corpus *corpus, uint64_t *rng, unsigned lines) {
+    for (unsigned i = 0; i < lines; i++) {
+        put_words(corpus, rng, 6 + below(rng, 10));
+        put_str(corpus, ".\n");
+    }
+}
+
+// a heading tree which mostly goes deeper, now and then climbing back out
+static void generate_deep_headings(Corpus *corpus, uint64_t *rng) {
+    unsigned level = 1;
+    for (unsigned i = 0; i < 64; i++) {
+        put_heading(corpus, rng, level);
+        put_paragraph(corpus, rng, 1 + below(rng, 3));
+
+        if (level < MAX_HEADING_DEPTH && !one_in(rng, 4)) {
+            level++;
+        } else {
+            level = 1 + below(rng, level);
+        }
+    }
+}
+
+static void put_list_item(Corpus *corpus, uint64_t *rng, unsigned depth, unsigned number) {
+    static const char *const bullets[] = {"-", "+", "%u.", "%u)"};
+
+    put_char(corpus, ' ', depth * 2);
+    put_format(corpus, bullets[depth % 4], number);
+    put_char(corpus, ' ', 1);
+    if (one_in(rng, 4)) put_str(corpus, one_in(rng, 2) ? "[ ] " : "[X] ");
+    put_words(corpus, rng, 3 + below(rng, 10));
+    put_char(corpus, '\n', 1);
+
+    // a continuation line, lined up under the item's text
+    if (one_in(rng, 4)) {
+        put_char(corpus, ' ', depth * 2 + 3);
+        put_words(corpus, rng, 3 + below(rng, 8));
+        put_char(corpus, '\n', 1);
+    }
+}
+
+// an outline that goes all the way down and then straight back out, so that
+// the next section's heading closes every level at once, as does the
+// paragraph under the list nested at the bottom of it
+static void generate_deep_outline(Corpus *corpus, uint64_t *rng) {
+    for (unsigned level = 1; level <= MAX_HEADING_DEPTH; level++) {
+        put_heading(corpus, rng, level);
+        if (one_in(rng, 2)) put_paragraph(corpus, rng, 1);
+    }
+    for (unsigned depth = 0; depth <= MAX_LIST_DEPTH; depth++) {
+        put_list_item(corpus, rng, depth, 1);
+    }
+    put_paragraph(corpus, rng, 1);
+}
+
+static void generate_nested_lists(Corpus *corpus, uint64_t *rng) {
+    put_heading(corpus, rng, 1);
+    put_paragraph(corpus, rng, 1);
+
+    unsigned numbers[MAX_LIST_DEPTH + 1] = {0};
+    unsigned depth = 0;
+    unsigned items = 50 + below(rng, 200);
+    for (unsigned i = 0; i < items; i++) {
+        put_list_item(corpus, rng, depth, ++numbers[depth]);
+
+        if (depth < MAX_LIST_DEPTH && one_in(rng, 3)) {
+            numbers[++depth] = 0;
+        } else if (depth > 0 && one_in(rng, 3)) {
+            depth -= 1 + below(rng, depth);
+        }
+    }
+
+    // a blank line ends every open list
+    put_char(corpus, '\n', 1);
+}
+
+// org writes drawer names in upper case, but the lower case ones are just as
+// valid and take a different path through the scanner, so have both
+static void generate_property_drawers(Corpus *corpus, uint64_t *rng) {
+    for (unsigned i = 0; i < 16; i++) {
+        put_heading(corpus, rng, i == 0 ? 1 : 1 + below(rng, 3));
+
+        bool lower = one_in(rng, 2);
+        put_str(corpus, lower ? ":properties:\n" : ":PROPERTIES:\n");
+        unsigned properties = 3 + below(rng, 6);
+        for (unsigned j = 0; j < properties; j++) {
+            put_format(corpus, ":%s: ", PICK(rng, property_names));
+            switch (below(rng, 3)) {
+                case 0:
+                    put_timestamp(corpus, rng, '[', ']');
+                    break;
+                case 1:
+                    put_format(corpus, "%08x-%04x-%04x",
+                               (unsigned) next_random(rng), below(rng, 0x10000), below(rng, 0x10000));
+                    break;
+                default:
+                    put_words(corpus, rng, 1 + below(rng, 3));
+                    break;
+            }
+            put_char(corpus, '\n', 1);
+        }
+        put_str(corpus, lower ? ":end:\n" : ":END:\n");
+
+        if (one_in(rng, 3)) {
+            put_str(corpus, ":LOGBOOK:\n");
+            put_str(corpus, "CLOCK: ");
+            put_timestamp(corpus, rng, '[', ']');
+            put_str(corpus, "--");
+            put_timestamp(corpus, rng, '[', ']');
+            put_format(corpus, " => %2u:%02u\n", below(rng, 10), below(rng, 60));
+            put_str(corpus, ":END:\n");
+        }
+
+        put_paragraph(corpus, rng, 1 + below(rng, 2));
+    }
+}
+
+static void generate_src_blocks(Corpus *corpus, uint64_t *rng) {
+    put_heading(corpus, rng, 1);
+    put_paragraph(corpus, rng, 1);
+
+    put_format(corpus, "#+begin_src %s\n", PICK(rng, languages));
+    unsigned lines = 50 + below(rng, 350);
+    for (unsigned i = 0; i < lines; i++) {
+        put_char(corpus, ' ', 4 * below(rng, 4));
+        put_str(corpus, PICK(rng, code_lines));
+        put_char(corpus, '\n', 1);
+    }
+    put_str(corpus, "#+end_src\n");
+}
+
+static void generate_markup_dense(Corpus *corpus, uint64_t *rng) {
+    static const char delimiters[] = {'*', '/', '_', '=', '~', '+'};
+
+    put_heading(corpus, rng, 1);
+    for (unsigned line = 0; line < 32; line++) {
+        unsigned count = 6 + below(rng, 10);
+        for (unsigned i = 0; i < count; i++) {
+            if (i > 0) put_char(corpus, ' ', 1);
+
+            if (below(rng, 5) < 3) {
+                char outer = PICK(rng, delimiters);
+                put_char(corpus, outer, 1);
+                if (one_in(rng, 6)) {
+                    // nested, e.g. */both/*
+                    char inner = PICK(rng, delimiters);
+                    if (inner == outer) inner = '/';
+                    put_char(corpus, inner, 1);
+                    put_words(corpus, rng, 1 + below(rng, 3));
+                    put_char(corpus, inner, 1);
+                } else {
+                    put_words(corpus, rng, 1 + below(rng, 3));
+                }
+                put_char(corpus, outer, 1);
+            } else {
+                put_str(corpus, PICK(rng, words));
+            }
+        }
+        put_str(corpus, ".\n");
+    }
+}
+
+static void put_link(Corpus *corpus, uint64_t *rng) {
+    switch (below(rng, 4)) {
+        case 0:
+            put_format(corpus, "[[https://example.org/%s/%u][", PICK(rng, words), below(rng, 100000));
+            put_words(corpus, rng, 1 + below(rng, 4));
+            put_str(corpus, "]]");
+            break;
+        case 1:
+            put_format(corpus, "[[file:notes/%s.org::*%s]]", PICK(rng, words), PICK(rng, words));
+            break;
+        case 2:
+            put_format(corpus, "[[id:%08x-%04x]]", (unsigned) next_random(rng), below(rng, 0x10000));
+            break;
+        default:
+            put_format(corpus, "[[#%s-%u]]", PICK(rng, words), below(rng, 1000));
+            break;
+    }
+}
+
+static void generate_link_heavy(Corpus *corpus, uint64_t *rng) {
+    put_heading(corpus, rng, 1);
+    for (unsigned line = 0; line < 32; line++) {
+        if (one_in(rng, 3)) put_str(corpus, "- ");
+
+        unsigned count = 1 + below(rng, 4);
+        for (unsigned i = 0; i < count; i++) {
+            if (i > 0) put_char(corpus, ' ', 1);
+            put_words(corpus, rng, below(rng, 4));
+            put_char(corpus, ' ', 1);
+            put_link(corpus, rng);
+        }
+        put_char(corpus, '\n', 1);
+    }
+    put_char(corpus, '\n', 1);
+}
+
+// one big file with a bit of everything
+static void generate_large_file(Corpus *corpus, uint64_t *rng) {
+    // every kind but this one, which is last
+    corpus_kinds[below(rng, (unsigned) corpus_kind_count - 1)].generate_section(corpus, rng);
+}
+
+const CorpusKind corpus_kinds[] = {
+    {"deep_headings", "heading trees up to 24 levels deep", 1 * MiB, generate_deep_headings},
+    {"deep_outline", "24 level outlines, each closed all at once by the next", 1 * MiB, generate_deep_outline},
+    {"nested_lists", "long lists nested up to 8 levels, with checkboxes", 1 * MiB, generate_nested_lists},
+    {"property_drawers", "a property drawer, and sometimes a logbook, on every heading", 1 * MiB, generate_property_drawers},
+    {"src_blocks", "large #+begin_src blocks of code", 1 * MiB, generate_src_blocks},
+    {"markup_dense", "paragraphs where most words are marked up", 1 * MiB, generate_markup_dense},
+    {"link_heavy", "notes with several links on every line", 1 * MiB, generate_link_heavy},
+    {"large_file", "a single multi-megabyte file mixing all of the above", 16 * MiB, generate_large_file},
+};
+
+const size_t corpus_kind_count = sizeof(corpus_kinds) / sizeof(corpus_kinds[0]);
+
+const CorpusKind *corpus_kind(const char *name) {
+    for (size_t i = 0; i < corpus_kind_count; i++) {
+        if (strcmp(corpus_kinds[i].name, name) == 0) return &corpus_kinds[i];
+    }
+    return NULL;
+}
+
+void corpus_generate(Corpus *corpus, const CorpusKind *kind, uint64_t seed, size_t size) {
+    if (size == 0) size = kind->default_size;
+
+    uint64_t rng = seed;
+    corpus->size = 0;
+    corpus_reserve(corpus, size + 64 * KiB);
+    while (corpus->size < size) {
+        kind->generate_section(corpus, &rng);
+    }
+}
+
+void corpus_delete(Corpus *corpus) {
+    free(corpus->contents);
+    corpus->contents = NULL;
+    corpus->size = 0;
+    corpus->capacity = 0;
+}
@@ -0,0 +1,36 @@
+#ifndef TREE_SITTER_ORGMODE_BENCH_CORPUS_H_
+#define TREE_SITTER_ORGMODE_BENCH_CORPUS_H_
+
+// Reproducible synthetic org documents for the benchmarks. The same kind,
+// seed and size always give byte-for-byte the same document.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    char *contents;
+    size_t size;
+    size_t capacity;
+} Corpus;
+
+typedef struct {
+    const char *name;
+    const char *description;
+    size_t default_size;
+    // appends one self-contained section, starting with a level 1 heading
+    void (*generate_section)(Corpus *corpus, uint64_t *rng);
+} CorpusKind;
+
+extern const CorpusKind corpus_kinds[];
+extern const size_t corpus_kind_count;
+
+// returns NULL if there's no kind with this name
+const CorpusKind *corpus_kind(const char *name);
+
+// fills `corpus` with roughly `size` bytes, or the kind's default size when
+// `size` is 0, always ending at the end of a line
+void corpus_generate(Corpus *corpus, const CorpusKind *kind, uint64_t seed, size_t size);
+
+void corpus_delete(Corpus *corpus);
+
+#endif // TREE_SITTER_ORGMODE_BENCH_CORPUS_H_
@@ -0,0 +1,586 @@
+// Incremental reparse latency under editor-like edits.
+//
+// Each org file given (or, with none, the synthetic large_file corpus) is
+// parsed once, then every scenario below replays its edits through
+// ts_tree_edit and an incremental reparse. Each scenario reports one JSON
+// object per line with percentiles of the reparse time, the size of
+// ts_tree_get_changed_ranges, and the fraction of the new tree's nodes that
+// were reused from the old one.
+//
+//     orgmode-edit-bench [-s seed] [-n edits] [-b bytes] [-R] [file.org...]
+//
+// -n is the number of edits per scenario, -b the size of the generated
+// corpus, and -R skips the reuse count, which walks both trees every edit.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "corpus.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-orgmode.h>
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SEED 1
+#define DEFAULT_EDITS 100
+
+// keystrokes typed into each heading title
+#define TYPED_TITLE " and more"
+
+typedef struct {
+    uint64_t seed;
+    unsigned edits;
+    size_t size;
+    bool count_reuse;
+} Options;
+
+typedef struct {
+    char *text;
+    uint32_t size;
+    uint32_t capacity;
+} Document;
+
+// a set of subtree addresses, open-addressed
+typedef struct {
+    uintptr_t *slots;
+    size_t capacity;
+    size_t count;
+} PointerSet;
+
+typedef struct {
+    const char *name;
+    double *times_ns;
+    unsigned count;
+    uint64_t changed_ranges;
+    uint64_t changed_bytes;
+    double reuse;
+} ScenarioResult;
+
+typedef struct {
+    const Options *options;
+    const char *file;
+    TSParser *parser;
+    TSTree *tree;
+    Document document;
+    PointerSet old_subtrees;
+    uint64_t rng;
+} Bench;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static uint64_t next_random(uint64_t *rng) {
+    uint64_t z = (*rng += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static void *checked_realloc(void *ptr, size_t size) {
+    void *result = realloc(ptr, size);
+    if (result == NULL) {
+        fprintf(stderr, "out of memory\n");
+        abort();
+    }
+    return result;
+}
+
+// TSNode.id points at the runtime's Subtree, which is either a small leaf
+// stored inline, tagged by its lowest bit, or a pointer to a node that's
+// shared by every tree it's reused in. Only the pointers can be compared.
+static uintptr_t subtree_address(TSNode node) {
+    uintptr_t subtree;
+    memcpy(&subtree, node.id, sizeof(subtree));
+    return (subtree & 1) ? 0 : subtree;
+}
+
+static size_t pointer_slot(const PointerSet *set, uintptr_t pointer) {
+    size_t slot = (size_t) ((pointer >> 4) * 0x9e3779b97f4a7c15) & (set->capacity - 1);
+    while (set->slots[slot] != 0 && set->slots[slot] != pointer) {
+        slot = (slot + 1) & (set->capacity - 1);
+    }
+    return slot;
+}
+
+static void pointer_set_insert(PointerSet *set, uintptr_t pointer) {
+    if ((set->count + 1) * 2 > set->capacity) {
+        PointerSet grown = {NULL, set->capacity == 0 ? 1024 : set->capacity * 2, 0};
+        grown.slots = checked_realloc(NULL, grown.capacity * sizeof(uintptr_t));
+        memset(grown.slots, 0, grown.capacity * sizeof(uintptr_t));
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (set->slots[i] != 0) grown.slots[pointer_slot(&grown, set->slots[i])] = set->slots[i];
+        }
+        grown.count = set->count;
+        free(set->slots);
+        *set = grown;
+    }
+
+    size_t slot = pointer_slot(set, pointer);
+    if (set->slots[slot] == 0) {
+        set->slots[slot] = pointer;
+        set->count++;
+    }
+}
+
+static bool pointer_set_contains(const PointerSet *set, uintptr_t pointer) {
+    return set->capacity > 0 && set->slots[pointer_slot(set, pointer)] == pointer;
+}
+
+static void pointer_set_clear(PointerSet *set) {
+    if (set->slots != NULL) memset(set->slots, 0, set->capacity * sizeof(uintptr_t));
+    set->count = 0;
+}
+
+static void collect_subtrees(PointerSet *set, TSNode root) {
+    pointer_set_clear(set);
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+
+    for (;;) {
+        uintptr_t address = subtree_address(ts_tree_cursor_current_node(&cursor));
+        if (address != 0) pointer_set_insert(set, address);
+
+        if (ts_tree_cursor_goto_first_child(&cursor)) continue;
+
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ts_tree_cursor_delete(&cursor);
+                return;
+            }
+        }
+    }
+}
+
+// the fraction of the nodes in the new tree which came from the old one. a
+// reused subtree brings all of its descendants along, so isn't descended into.
+static double reused_fraction(const PointerSet *old_subtrees, TSNode root) {
+    uint64_t reused = 0;
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+
+    for (;;) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        uintptr_t address = subtree_address(node);
+        if (address != 0 && pointer_set_contains(old_subtrees, address)) {
+            reused += ts_node_descendant_count(node);
+        } else if (ts_tree_cursor_goto_first_child(&cursor)) {
+            continue;
+        }
+
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ts_tree_cursor_delete(&cursor);
+                return (double) reused / ts_node_descendant_count(root);
+            }
+        }
+    }
+}
+
+static TSPoint point_at(const Document *document, uint32_t byte) {
+    TSPoint point = {0, 0};
+    uint32_t line_start = 0;
+    const char *text = document->text;
+
+    for (const char *newline; (newline = memchr(text + line_start, '\n', byte - line_start)) != NULL;) {
+        point.row++;
+        line_start = (uint32_t) (newline - text) + 1;
+    }
+
+    point.column = byte - line_start;
+    return point;
+}
+
+static TSPoint point_after(TSPoint start, const char *text, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        if (text[i] == '\n') {
+            start.row++;
+            start.column = 0;
+        } else {
+            start.column++;
+        }
+    }
+    return start;
+}
+
+// replaces `removed` bytes at `start` with `text`, and describes the edit
+static TSInputEdit document_replace(Document *document, uint32_t start, uint32_t removed, const char *text) {
+    uint32_t inserted = (uint32_t) strlen(text);
+    TSInputEdit edit = {
+        .start_byte = start,
+        .old_end_byte = start + removed,
+        .new_end_byte = start + inserted,
+        .start_point = point_at(document, start),
+        .old_end_point = point_at(document, start + removed),
+    };
+    edit.new_end_point = point_after(edit.start_point, text, inserted);
+
+    if (document->size - removed + inserted > document->capacity) {
+        document->capacity = (document->size - removed + inserted) * 2;
+        document->text = checked_realloc(document->text, document->capacity);
+    }
+
+    memmove(document->text + start + inserted,
+            document->text + start + removed,
+            document->size - start - removed);
+    memcpy(document->text + start, text, inserted);
+    document->size = document->size - removed + inserted;
+
+    return edit;
+}
+
+static TSTree *parse(Bench *bench, const TSTree *old_tree) {
+    TSTree *tree = ts_parser_parse_string(bench->parser, old_tree, bench->document.text, bench->document.size);
+    if (tree == NULL) {
+        fprintf(stderr, "%s: parse failed\n", bench->file);
+        exit(1);
+    }
+    return tree;
+}
+
+// applies one edit and reparses, adding to `result` if there is one, and
+// otherwise just putting the tree back in step with the document
+static void edit(Bench *bench, ScenarioResult *result, uint32_t start, uint32_t removed, const char *text) {
+    TSInputEdit input_edit = document_replace(&bench->document, start, removed, text);
+    ts_tree_edit(bench->tree, &input_edit);
+
+    bool count_reuse = result != NULL && bench->options->count_reuse;
+    if (count_reuse) collect_subtrees(&bench->old_subtrees, ts_tree_root_node(bench->tree));
+
+    double begin = now_ns();
+    TSTree *tree = parse(bench, bench->tree);
+    double elapsed = now_ns() - begin;
+
+    if (result != NULL) {
+        result->times_ns[result->count++] = elapsed;
+
+        uint32_t range_count;
+        TSRange *ranges = ts_tree_get_changed_ranges(bench->tree, tree, &range_count);
+        result->changed_ranges += range_count;
+        for (uint32_t i = 0; i < range_count; i++) {
+            result->changed_bytes += ranges[i].end_byte - ranges[i].start_byte;
+        }
+        free(ranges);
+
+        if (count_reuse) result->reuse += reused_fraction(&bench->old_subtrees, ts_tree_root_node(tree));
+    }
+
+    ts_tree_delete(bench->tree);
+    bench->tree = tree;
+}
+
+// Edit targets. Each returns the byte offsets of every place in the document
+// its scenario could edit, in order.
+
+typedef struct {
+    uint32_t *offsets;
+    uint32_t count;
+    uint32_t capacity;
+} Targets;
+
+static void targets_push(Targets *targets, uint32_t offset) {
+    if (targets->count == targets->capacity) {
+        targets->capacity = targets->capacity == 0 ? 256 : targets->capacity * 2;
+        targets->offsets = checked_realloc(targets->offsets, targets->capacity * sizeof(uint32_t));
+    }
+    targets->offsets[targets->count++] = offset;
+}
+
+static bool is_heading(const Document *document, uint32_t line) {
+    uint32_t i = line;
+    while (i < document->size && document->text[i] == '*') i++;
+    return i > line && i < document->size && document->text[i] == ' ';
+}
+
+// the start of every line for which `matches` is true
+static void find_lines(const Document *document, Targets *targets,
+                       bool (*matches)(const Document *, uint32_t)) {
+    for (uint32_t line = 0; line < document->size;) {
+        if (matches(document, line)) targets_push(targets, line);
+
+        const char *newline = memchr(document->text + line, '\n', document->size - line);
+        if (newline == NULL) break;
+        line = (uint32_t) (newline - document->text) + 1;
+    }
+}
+
+static bool starts_with(const Document *document, uint32_t offset, const char *prefix) {
+    size_t length = strlen(prefix);
+    return document->size - offset >= length && memcmp(document->text + offset, prefix, length) == 0;
+}
+
+static bool is_property_drawer(const Document *document, uint32_t line) {
+    return starts_with(document, line, ":PROPERTIES:\n") || starts_with(document, line, ":properties:\n");
+}
+
+// a line of paragraph text, which an unclosed block would swallow
+static bool is_paragraph(const Document *document, uint32_t line) {
+    return line < document->size && document->text[line] >= 'a' && document->text[line] <= 'z';
+}
+
+static void find_checkboxes(const Document *document, Targets *targets) {
+    for (uint32_t i = 0; i + 3 < document->size; i++) {
+        if (starts_with(document, i, "[ ] ") || starts_with(document, i, "[X] ")) {
+            targets_push(targets, i + 1);
+        }
+    }
+}
+
+static void find_heading_ends(const Document *document, Targets *targets) {
+    Targets lines = {0};
+    find_lines(document, &lines, is_heading);
+    for (uint32_t i = 0; i < lines.count; i++) {
+        const char *newline = memchr(document->text + lines.offsets[i], '\n', document->size - lines.offsets[i]);
+        targets_push(targets, newline == NULL ? document->size : (uint32_t) (newline - document->text));
+    }
+    free(lines.offsets);
+}
+
+// picks `count` of the targets at random, then orders them last to first, so
+// editing one never moves the ones still to come
+static void choose_targets(Bench *bench, Targets *targets, unsigned count) {
+    if (targets->count == 0) return;
+
+    uint32_t *chosen = checked_realloc(NULL, count * sizeof(uint32_t));
+    for (unsigned i = 0; i < count; i++) {
+        chosen[i] = targets->offsets[next_random(&bench->rng) % targets->count];
+    }
+
+    for (unsigned i = 1; i < count; i++) {
+        for (unsigned j = i; j > 0 && chosen[j - 1] < chosen[j]; j--) {
+            uint32_t t = chosen[j];
+            chosen[j] = chosen[j - 1];
+            chosen[j - 1] = t;
+        }
+    }
+
+    free(targets->offsets);
+    targets->offsets = chosen;
+    targets->count = count;
+}
+
+// Scenarios. Each makes (about) `edits` measured edits to the document.
+
+static void type_in_heading_titles(Bench *bench, ScenarioResult *result, unsigned edits) {
+    const unsigned per_heading = sizeof(TYPED_TITLE) - 1;
+    Targets targets = {0};
+    find_heading_ends(&bench->document, &targets);
+    choose_targets(bench, &targets, (edits + per_heading - 1) / per_heading);
+
+    for (uint32_t i = 0; i < targets.count && result->count < edits; i++) {
+        for (unsigned j = 0; j < per_heading && result->count < edits; j++) {
+            char keystroke[2] = {TYPED_TITLE[j], '\0'};
+            edit(bench, result, targets.offsets[i] + j, 0, keystroke);
+        }
+    }
+    free(targets.offsets);
+}
+
+static void toggle_checkboxes(Bench *bench, ScenarioResult *result, unsigned edits) {
+    Targets targets = {0};
+    find_checkboxes(&bench->document, &targets);
+    choose_targets(bench, &targets, edits);
+
+    for (uint32_t i = 0; i < targets.count; i++) {
+        uint32_t offset = targets.offsets[i];
+        edit(bench, result, offset, 1, bench->document.text[offset] == ' ' ? "X" : " ");
+    }
+    free(targets.offsets);
+}
+
+static void add_properties(Bench *bench, ScenarioResult *result, unsigned edits) {
+    Targets targets = {0};
+    find_lines(&bench->document, &targets, is_property_drawer);
+    choose_targets(bench, &targets, edits);
+
+    for (uint32_t i = 0; i < targets.count; i++) {
+        uint32_t after_drawer_name = targets.offsets[i] + (uint32_t) strlen(":PROPERTIES:\n");
+        edit(bench, result, after_drawer_name, 0, ":BENCH_EDIT: added\n");
+    }
+    free(targets.offsets);
+}
+
+// the block is never closed, so runs to the end of the section; it's taken
+// back out (unmeasured) before the next one is opened
+static void open_unclosed_src_blocks(Bench *bench, ScenarioResult *result, unsigned edits) {
+    static const char block_start[] = "#+begin_src c\n";
+
+    Targets targets = {0};
+    find_lines(&bench->document, &targets, is_paragraph);
+    choose_targets(bench, &targets, edits);
+
+    for (uint32_t i = 0; i < targets.count; i++) {
+        edit(bench, result, targets.offsets[i], 0, block_start);
+        edit(bench, NULL, targets.offsets[i], sizeof(block_start) - 1, "");
+    }
+    free(targets.offsets);
+}
+
+// demotes a heading, then promotes it back, both measured
+static void promote_and_demote_headings(Bench *bench, ScenarioResult *result, unsigned edits) {
+    Targets targets = {0};
+    find_lines(&bench->document, &targets, is_heading);
+    choose_targets(bench, &targets, (edits + 1) / 2);
+
+    for (uint32_t i = 0; i < targets.count; i++) {
+        edit(bench, result, targets.offsets[i], 0, "*");
+        edit(bench, result->count < edits ? result : NULL, targets.offsets[i], 1, "");
+    }
+    free(targets.offsets);
+}
+
+static const struct {
+    const char *name;
+    void (*run)(Bench *bench, ScenarioResult *result, unsigned edits);
+} scenarios[] = {
+    {"type_in_heading_title", type_in_heading_titles},
+    {"toggle_checkbox", toggle_checkboxes},
+    {"add_property", add_properties},
+    {"open_unclosed_src_block", open_unclosed_src_blocks},
+    {"promote_demote_heading", promote_and_demote_headings},
+};
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static double percentile(const double *sorted, unsigned count, double p) {
+    unsigned rank = (unsigned) ceil(p * count);
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+static void report(const Bench *bench, ScenarioResult *result) {
+    if (result->count == 0) {
+        printf("{\"file\":\"%s\",\"bytes\":%u,\"scenario\":\"%s\",\"edits\":0}\n",
+               bench->file, bench->document.size, result->name);
+        return;
+    }
+
+    double total = 0;
+    for (unsigned i = 0; i < result->count; i++) total += result->times_ns[i];
+    qsort(result->times_ns, result->count, sizeof(double), compare_doubles);
+
+    double n = result->count;
+    printf("{\"file\":\"%s\",\"bytes\":%u,\"scenario\":\"%s\",\"edits\":%u,"
+           "\"p50_us\":%.1f,\"p99_us\":%.1f,\"mean_us\":%.1f,\"max_us\":%.1f,"
+           "\"changed_ranges_per_edit\":%.2f,\"changed_bytes_per_edit\":%.0f",
+           bench->file, bench->document.size, result->name, result->count,
+           percentile(result->times_ns, result->count, 0.5) / 1e3,
+           percentile(result->times_ns, result->count, 0.99) / 1e3,
+           total / n / 1e3,
+           result->times_ns[result->count - 1] / 1e3,
+           result->changed_ranges / n, result->changed_bytes / n);
+    if (bench->options->count_reuse) printf(",\"reused_fraction\":%.4f", result->reuse / n);
+    printf("}\n");
+    fflush(stdout);
+}
+
+static bool read_file(const char *path, Document *document) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    document->size = 0;
+    for (;;) {
+        if (document->capacity - document->size < 64 * 1024) {
+            document->capacity = document->capacity == 0 ? 1024 * 1024 : document->capacity * 2;
+            document->text = checked_realloc(document->text, document->capacity);
+        }
+        size_t read = fread(document->text + document->size, 1, document->capacity - document->size, file);
+        document->size += (uint32_t) read;
+        if (read == 0) break;
+    }
+
+    bool ok = !ferror(file);
+    if (!ok) perror(path);
+    fclose(file);
+    return ok;
+}
+
+static void run_document(const Options *options, const char *file, Document document) {
+    Bench bench = {options, file, ts_parser_new(), NULL, document, {NULL, 0, 0}, options->seed};
+    ts_parser_set_language(bench.parser, tree_sitter_orgmode());
+
+    double begin = now_ns();
+    bench.tree = parse(&bench, NULL);
+    printf("{\"file\":\"%s\",\"bytes\":%u,\"scenario\":\"initial_parse\",\"us\":%.1f}\n",
+           file, bench.document.size, (now_ns() - begin) / 1e3);
+
+    double *times_ns = checked_realloc(NULL, options->edits * sizeof(double));
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        ScenarioResult result = {scenarios[i].name, times_ns, 0, 0, 0, 0};
+        scenarios[i].run(&bench, &result, options->edits);
+        report(&bench, &result);
+    }
+
+    free(times_ns);
+    free(bench.old_subtrees.slots);
+    free(bench.document.text);
+    ts_tree_delete(bench.tree);
+    ts_parser_delete(bench.parser);
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [-s seed] [-n edits] [-b bytes] [-R] [file.org...]\n", program);
+}
+
+int main(int argc, char **argv) {
+    Options options = {DEFAULT_SEED, DEFAULT_EDITS, 0, true};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:b:R")) != -1) {
+        switch (opt) {
+            case 's':
+                options.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'n':
+                options.edits = (unsigned) strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                options.size = strtoull(optarg, NULL, 10);
+                break;
+            case 'R':
+                options.count_reuse = false;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (options.edits == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (optind == argc) {
+        Corpus corpus = {0};
+        corpus_generate(&corpus, corpus_kind("large_file"), options.seed, options.size);
+        Document document = {corpus.contents, (uint32_t) corpus.size, (uint32_t) corpus.capacity};
+        run_document(&options, "large_file", document);
+        return 0;
+    }
+
+    int failures = 0;
+    for (int i = optind; i < argc; i++) {
+        Document document = {NULL, 0, 0};
+        if (read_file(argv[i], &document)) {
+            run_document(&options, argv[i], document);
+        } else {
+            free(document.text);
+            failures++;
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
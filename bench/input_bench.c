@@ -0,0 +1,262 @@
+// Parsing each synthetic corpus (see corpus.c) from a file, mapped into
+// memory and streamed in chunks of a few sizes, against parsing it from a
+// string.
+//
+// Each way of reading reports one JSON object per line with the best time
+// over a few parses, the memory it needed on top of the tree, and whether the
+// tree is the same, down to the positions of its nodes, as the string's. The
+// smallest chunks are there to cut the corpora's accented characters in two.
+//
+//     orgmode-input-bench [-s seed] [-n repeats] [-b bytes] [-l] [corpus...]
+//
+// -b sets the size of every corpus instead of its default, and -l lists the
+// corpora. The exit status is 1 if a tree differs from the string's.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "corpus.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-orgmode-runtime.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SEED 1
+#define DEFAULT_REPEATS 3
+
+static const uint32_t chunk_sizes[] = {5, 4096, 65536, 1 << 20};
+
+typedef struct {
+    uint64_t seed;
+    unsigned repeats;
+    size_t size;
+} Options;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static bool same_point(TSPoint a, TSPoint b) {
+    return a.row == b.row && a.column == b.column;
+}
+
+// the same nodes, in the same places
+static bool same_tree(TSNode a, TSNode b) {
+    if (ts_node_symbol(a) != ts_node_symbol(b) ||
+        ts_node_start_byte(a) != ts_node_start_byte(b) ||
+        ts_node_end_byte(a) != ts_node_end_byte(b) ||
+        !same_point(ts_node_start_point(a), ts_node_start_point(b)) ||
+        !same_point(ts_node_end_point(a), ts_node_end_point(b)) ||
+        ts_node_is_missing(a) != ts_node_is_missing(b)) {
+        return false;
+    }
+
+    uint32_t count = ts_node_child_count(a);
+    if (count != ts_node_child_count(b)) return false;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!same_tree(ts_node_child(a, i), ts_node_child(b, i))) return false;
+    }
+    return true;
+}
+
+// writes the corpus to a new file, returning its path, which the caller
+// frees and unlinks
+static char *write_corpus(const CorpusKind *kind, const Corpus *corpus) {
+    const char *dir = getenv("TMPDIR");
+    if (dir == NULL || dir[0] == '\0') dir = "/tmp";
+    size_t length = strlen(dir) + sizeof("/orgmode-input-XXXXXX");
+    char *path = malloc(length);
+    if (path == NULL) abort();
+    snprintf(path, length, "%s/orgmode-input-XXXXXX", dir);
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "%s: can't make a file in %s: %s\n", kind->name, dir, strerror(errno));
+        exit(1);
+    }
+    for (size_t written = 0; written < corpus->size;) {
+        ssize_t n = write(fd, corpus->contents + written, corpus->size - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            fprintf(stderr, "%s: can't write %s: %s\n", kind->name, path, strerror(errno));
+            unlink(path);
+            exit(1);
+        }
+        written += (size_t) n;
+    }
+    close(fd);
+    return path;
+}
+
+static bool report(
+    const Options *options,
+    const CorpusKind *kind,
+    size_t size,
+    const char *input,
+    uint32_t chunk_size,
+    size_t extra_bytes,
+    double string_ns,
+    double best_ns,
+    bool agrees
+) {
+    printf("{\"corpus\":\"%s\",\"seed\":%llu,\"bytes\":%zu,\"input\":\"%s\",\"chunk_size\":%u,"
+           "\"extra_bytes\":%zu,\"string_ns\":%.0f,\"best_ns\":%.0f,\"mb_per_s\":%.1f,\"agrees\":%s}\n",
+           kind->name, (unsigned long long) options->seed, size, input, chunk_size, extra_bytes,
+           string_ns, best_ns, (double) size / best_ns * 1e3, agrees ? "true" : "false");
+    fflush(stdout);
+    if (!agrees) fprintf(stderr, "%s: the %s parse differs from the string's\n", kind->name, input);
+    return agrees;
+}
+
+static int run_corpus(const Options *options, const CorpusKind *kind) {
+    Corpus corpus = {0};
+    corpus_generate(&corpus, kind, options->seed, options->size);
+    char *path = write_corpus(kind, &corpus);
+
+    TSParser *parser = ts_parser_new();
+    if (!ts_parser_set_language(parser, tree_sitter_orgmode())) {
+        fprintf(stderr, "%s: incompatible language version\n", kind->name);
+        exit(1);
+    }
+
+    TSTree *expected = NULL;
+    double string_ns = 0;
+    for (unsigned i = 0; i < options->repeats; i++) {
+        if (expected != NULL) ts_tree_delete(expected);
+        double start = now_ns();
+        expected = ts_parser_parse_string(parser, NULL, corpus.contents, (uint32_t) corpus.size);
+        double elapsed = now_ns() - start;
+        if (i == 0 || elapsed < string_ns) string_ns = elapsed;
+    }
+    if (expected == NULL) {
+        fprintf(stderr, "%s: parse failed\n", kind->name);
+        exit(1);
+    }
+    TSNode root = ts_tree_root_node(expected);
+    int failures = 0;
+
+    // mapping the file each time is part of reading it this way
+    double best_ns = 0;
+    bool agrees = true;
+    for (unsigned i = 0; i < options->repeats; i++) {
+        double start = now_ns();
+        TSOrgmodeMappedFile file;
+        if (!tree_sitter_orgmode_mapped_file_open(&file, path)) {
+            fprintf(stderr, "%s: can't map %s: %s\n", kind->name, path, strerror(errno));
+            exit(1);
+        }
+        TSTree *tree = ts_parser_parse(parser, NULL, tree_sitter_orgmode_mapped_input(&file));
+        double elapsed = now_ns() - start;
+        if (i == 0 || elapsed < best_ns) best_ns = elapsed;
+
+        if (i == 0) agrees = tree != NULL && same_tree(root, ts_tree_root_node(tree));
+        if (tree != NULL) ts_tree_delete(tree);
+        tree_sitter_orgmode_mapped_file_close(&file);
+    }
+    if (!report(options, kind, corpus.size, "mapped", 0, 0, string_ns, best_ns, agrees)) failures = 1;
+
+    FILE *stream_file = fopen(path, "rb");
+    if (stream_file == NULL) {
+        fprintf(stderr, "%s: can't open %s: %s\n", kind->name, path, strerror(errno));
+        exit(1);
+    }
+    for (size_t c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); c++) {
+        TSOrgmodeFileStream stream;
+        if (!tree_sitter_orgmode_file_stream_init(&stream, fileno(stream_file), chunk_sizes[c])) {
+            fprintf(stderr, "%s: out of memory\n", kind->name);
+            exit(1);
+        }
+
+        for (unsigned i = 0; i < options->repeats; i++) {
+            double start = now_ns();
+            TSTree *tree = ts_parser_parse(parser, NULL, tree_sitter_orgmode_stream_input(&stream));
+            double elapsed = now_ns() - start;
+            if (i == 0 || elapsed < best_ns) best_ns = elapsed;
+
+            if (stream.failed) {
+                fprintf(stderr, "%s: can't read %s: %s\n", kind->name, path, strerror(stream.error));
+                exit(1);
+            }
+            if (i == 0) agrees = tree != NULL && same_tree(root, ts_tree_root_node(tree));
+            if (tree != NULL) ts_tree_delete(tree);
+        }
+
+        if (!report(options, kind, corpus.size, "stream", stream.chunk_size, stream.chunk_size,
+                    string_ns, best_ns, agrees)) {
+            failures = 1;
+        }
+        tree_sitter_orgmode_file_stream_delete(&stream);
+    }
+    fclose(stream_file);
+
+    ts_tree_delete(expected);
+    ts_parser_delete(parser);
+    unlink(path);
+    free(path);
+    corpus_delete(&corpus);
+    return failures;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [-s seed] [-n repeats] [-b bytes] [-l] [corpus...]\n", program);
+}
+
+int main(int argc, char **argv) {
+    Options options = {DEFAULT_SEED, DEFAULT_REPEATS, 0};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:b:l")) != -1) {
+        switch (opt) {
+            case 's':
+                options.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'n':
+                options.repeats = (unsigned) strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                options.size = strtoull(optarg, NULL, 10);
+                break;
+            case 'l':
+                for (size_t i = 0; i < corpus_kind_count; i++) {
+                    printf("%-18s %s\n", corpus_kinds[i].name, corpus_kinds[i].description);
+                }
+                return 0;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (options.repeats == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int failures = 0;
+    if (optind == argc) {
+        for (size_t i = 0; i < corpus_kind_count; i++) {
+            failures += run_corpus(&options, &corpus_kinds[i]);
+        }
+    } else {
+        for (int i = optind; i < argc; i++) {
+            const CorpusKind *kind = corpus_kind(argv[i]);
+            if (kind == NULL) {
+                fprintf(stderr, "unknown corpus '%s'; -l lists them\n", argv[i]);
+                failures++;
+                continue;
+            }
+            failures += run_corpus(&options, kind);
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,302 @@
+// Throughput of tree_sitter_orgmode_outline, checked against the parser.
+//
+// Every synthetic corpus (see corpus.c) is indexed a few times, and then
+// parsed once. Each reports one JSON object per line with the index's speed,
+// how many of each kind of entry it found, the parse's time for comparison,
+// and whether the two agree. Only the top level sections that parse without
+// errors are compared, since the index has no error recovery to match.
+//
+//     orgmode-outline-bench [-s seed] [-n repeats] [-b bytes] [-x] [-l] [corpus...]
+//
+// -b sets the size of every corpus instead of its default, -x leaves out the
+// parse, for corpora too big to parse in a reasonable time, and -l lists the
+// corpora. The exit status is 1 if the index and the parser disagree.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "corpus.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-orgmode.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SEED 1
+#define DEFAULT_REPEATS 5
+
+typedef struct {
+    uint64_t seed;
+    unsigned repeats;
+    size_t size;
+    bool check;
+} Options;
+
+// the entries the parser finds, in the same form as the index's
+typedef struct {
+    const char *text;
+    TSOrgmodeOutline found;
+} Collector;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static void push_entry(TSOrgmodeOutline *outline, TSOrgmodeOutlineEntry entry) {
+    if (outline->count == outline->capacity) {
+        outline->capacity = outline->capacity < 64 ? 64 : outline->capacity * 2;
+        outline->entries = realloc(outline->entries, outline->capacity * sizeof(entry));
+        if (outline->entries == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    outline->entries[outline->count++] = entry;
+}
+
+static bool has_child(TSNode node, const char *type) {
+    uint32_t count = ts_node_child_count(node);
+    for (uint32_t i = 0; i < count; i++) {
+        if (strcmp(ts_node_type(ts_node_child(node, i)), type) == 0) return true;
+    }
+    return false;
+}
+
+static TSOrgmodeOutlineEntry entry_for(TSNode node, TSOrgmodeOutlineKind kind, uint32_t level) {
+    return (TSOrgmodeOutlineEntry) {
+        .kind = kind,
+        .level = level,
+        .start_byte = ts_node_start_byte(node),
+        .start_row = ts_node_start_point(node).row,
+        .end_byte = ts_node_end_byte(node),
+        .end_row = ts_node_end_point(node).row,
+        .closed = true,
+    };
+}
+
+// `depth` is the number of blocks and drawers the node is in
+static void collect(Collector *c, TSNode node, uint32_t depth) {
+    const char *type = ts_node_type(node);
+
+    if (strcmp(type, "heading") == 0) {
+        TSNode stars = ts_node_child(node, 0);
+        uint32_t level = ts_node_end_byte(stars) - ts_node_start_byte(stars);
+        push_entry(&c->found, entry_for(node, TS_ORGMODE_OUTLINE_HEADING, level));
+        return;
+    }
+
+    if (strcmp(type, "greater_block") == 0) {
+        TSOrgmodeOutlineEntry entry = entry_for(node, TS_ORGMODE_OUTLINE_BLOCK, depth++);
+        entry.closed = has_child(node, "block_end_name");
+        push_entry(&c->found, entry);
+    } else if (strcmp(type, "drawer") == 0) {
+        TSNode name = ts_node_child(node, 0);
+        const char *text = c->text + ts_node_start_byte(name);
+        bool properties = ts_node_end_byte(name) - ts_node_start_byte(name) == strlen(":properties:") &&
+            memcmp(text, ":properties:", strlen(":properties:")) == 0;
+
+        TSOrgmodeOutlineEntry entry = entry_for(
+            node, properties ? TS_ORGMODE_OUTLINE_PROPERTY_DRAWER : TS_ORGMODE_OUTLINE_DRAWER, depth++);
+        entry.closed = has_child(node, "drawer_end");
+        push_entry(&c->found, entry);
+    }
+
+    uint32_t count = ts_node_child_count(node);
+    for (uint32_t i = 0; i < count; i++) {
+        collect(c, ts_node_child(node, i), depth);
+    }
+}
+
+// where a heading or an unclosed block or drawer ends isn't comparable: the
+// parser's runs on over the blank lines after it
+static bool same_entry(const TSOrgmodeOutlineEntry *a, const TSOrgmodeOutlineEntry *b) {
+    if (a->kind != b->kind || a->level != b->level || a->start_byte != b->start_byte ||
+        a->start_row != b->start_row || a->closed != b->closed) {
+        return false;
+    }
+    if (a->kind == TS_ORGMODE_OUTLINE_HEADING || !a->closed) return true;
+    return a->end_byte == b->end_byte && a->end_row == b->end_row;
+}
+
+static void print_entry(const char *label, const TSOrgmodeOutlineEntry *entry) {
+    static const char *const kinds[] = {"heading", "block", "drawer", "property drawer"};
+    if (entry == NULL) {
+        fprintf(stderr, "  %s: nothing\n", label);
+        return;
+    }
+    fprintf(stderr, "  %s: %s, level %u, bytes %u-%u, rows %u-%u%s\n", label,
+            kinds[entry->kind], entry->level, entry->start_byte, entry->end_byte,
+            entry->start_row, entry->end_row, entry->closed ? "" : ", not closed");
+}
+
+typedef struct {
+    double parse_ns;
+    size_t checked_bytes;
+    bool agrees;
+} CheckResult;
+
+// compares the index with the parser over every top level section, or text
+// before the first heading, which parses without errors
+static CheckResult check(const CorpusKind *kind, const Corpus *corpus, const TSOrgmodeOutline *outline) {
+    CheckResult result = {0, 0, true};
+
+    TSParser *parser = ts_parser_new();
+    if (!ts_parser_set_language(parser, tree_sitter_orgmode())) {
+        fprintf(stderr, "%s: incompatible language version\n", kind->name);
+        exit(1);
+    }
+
+    double start = now_ns();
+    TSTree *tree = ts_parser_parse_string(parser, NULL, corpus->contents, (uint32_t) corpus->size);
+    result.parse_ns = now_ns() - start;
+    if (tree == NULL) {
+        fprintf(stderr, "%s: parse failed\n", kind->name);
+        exit(1);
+    }
+
+    Collector collector = {corpus->contents, {NULL, 0, 0}};
+    TSNode root = ts_tree_root_node(tree);
+    uint32_t index = 0;
+
+    for (uint32_t i = 0, count = ts_node_child_count(root); i < count && result.agrees; i++) {
+        TSNode region = ts_node_child(root, i);
+        uint32_t region_start = ts_node_start_byte(region);
+        uint32_t region_end = ts_node_end_byte(region);
+
+        // the index's entries before this region were in ones that were skipped
+        while (index < outline->count && outline->entries[index].start_byte < region_start) index++;
+        if (ts_node_has_error(region)) continue;
+
+        collector.found.count = 0;
+        collect(&collector, region, 0);
+        result.checked_bytes += region_end - region_start;
+
+        for (uint32_t j = 0; j <= collector.found.count; j++, index++) {
+            const TSOrgmodeOutlineEntry *parsed = j < collector.found.count ? &collector.found.entries[j] : NULL;
+            const TSOrgmodeOutlineEntry *indexed = index < outline->count && outline->entries[index].start_byte < region_end
+                ? &outline->entries[index] : NULL;
+            if (parsed == NULL && indexed == NULL) break;
+
+            if (parsed == NULL || indexed == NULL || !same_entry(parsed, indexed)) {
+                fprintf(stderr, "%s: the index and the parser disagree\n", kind->name);
+                print_entry("parser", parsed);
+                print_entry("index", indexed);
+                result.agrees = false;
+                break;
+            }
+        }
+    }
+
+    free(collector.found.entries);
+    ts_tree_delete(tree);
+    ts_parser_delete(parser);
+    return result;
+}
+
+static int run_corpus(const Options *options, const CorpusKind *kind) {
+    Corpus corpus = {0};
+    corpus_generate(&corpus, kind, options->seed, options->size);
+
+    TSOrgmodeOutline outline = {NULL, 0, 0};
+    double best_ns = 0;
+    for (unsigned i = 0; i < options->repeats; i++) {
+        double start = now_ns();
+        if (!tree_sitter_orgmode_outline(&outline, corpus.contents, corpus.size)) {
+            fprintf(stderr, "%s: couldn't index\n", kind->name);
+            return 1;
+        }
+        double elapsed = now_ns() - start;
+        if (i == 0 || elapsed < best_ns) best_ns = elapsed;
+    }
+
+    unsigned counts[TS_ORGMODE_OUTLINE_PROPERTY_DRAWER + 1] = {0};
+    for (uint32_t i = 0; i < outline.count; i++) counts[outline.entries[i].kind]++;
+
+    printf("{\"corpus\":\"%s\",\"seed\":%llu,\"bytes\":%zu,\"repeats\":%u,"
+           "\"best_ns\":%.0f,\"gb_per_s\":%.2f,\"entries\":%u,\"headings\":%u,"
+           "\"blocks\":%u,\"drawers\":%u,\"property_drawers\":%u",
+           kind->name, (unsigned long long) options->seed, corpus.size, options->repeats,
+           best_ns, corpus.size / best_ns, outline.count, counts[TS_ORGMODE_OUTLINE_HEADING],
+           counts[TS_ORGMODE_OUTLINE_BLOCK], counts[TS_ORGMODE_OUTLINE_DRAWER],
+           counts[TS_ORGMODE_OUTLINE_PROPERTY_DRAWER]);
+
+    bool agrees = true;
+    if (options->check) {
+        CheckResult result = check(kind, &corpus, &outline);
+        agrees = result.agrees;
+        printf(",\"parse_ns\":%.0f,\"speedup\":%.1f,\"checked_bytes\":%zu,\"agrees\":%s",
+               result.parse_ns, result.parse_ns / best_ns, result.checked_bytes,
+               agrees ? "true" : "false");
+    }
+    printf("}\n");
+    fflush(stdout);
+
+    tree_sitter_orgmode_outline_delete(&outline);
+    corpus_delete(&corpus);
+    return agrees ? 0 : 1;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [-s seed] [-n repeats] [-b bytes] [-x] [-l] [corpus...]\n", program);
+}
+
+int main(int argc, char **argv) {
+    Options options = {DEFAULT_SEED, DEFAULT_REPEATS, 0, true};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:b:xl")) != -1) {
+        switch (opt) {
+            case 's':
+                options.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'n':
+                options.repeats = (unsigned) strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                options.size = strtoull(optarg, NULL, 10);
+                break;
+            case 'x':
+                options.check = false;
+                break;
+            case 'l':
+                for (size_t i = 0; i < corpus_kind_count; i++) {
+                    printf("%-18s %s\n", corpus_kinds[i].name, corpus_kinds[i].description);
+                }
+                return 0;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (options.repeats == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int failures = 0;
+    if (optind == argc) {
+        for (size_t i = 0; i < corpus_kind_count; i++) {
+            failures += run_corpus(&options, &corpus_kinds[i]);
+        }
+    } else {
+        for (int i = optind; i < argc; i++) {
+            const CorpusKind *kind = corpus_kind(argv[i]);
+            if (kind == NULL) {
+                fprintf(stderr, "unknown corpus '%s'; -l lists them\n", argv[i]);
+                failures++;
+                continue;
+            }
+            failures += run_corpus(&options, kind);
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+// Parsing each synthetic corpus (see corpus.c) split at its level 1 headings
+// on a growing number of threads, against one parser parsing all of it.
+//
+// Each thread count reports one JSON object per line with the best time
+// over a few parses, its speedup over the single parser, and whether the
+// stitched sections are the same, down to the positions of their nodes, as
+// the top level of the single parser's tree. That's only checked when the
+// whole document parses without errors, as error recovery can't reach past
+// a chunk.
+//
+//     orgmode-parallel-bench [-s seed] [-n repeats] [-b bytes] [-j threads] [-l] [corpus...]
+//
+// -b sets the size of every corpus instead of its default, -j the most
+// threads to try (default one for each CPU), and -l lists the corpora. The
+// exit status is 1 if a parallel parse differs from the single one.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "corpus.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-orgmode-runtime.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SEED 1
+#define DEFAULT_REPEATS 3
+
+typedef struct {
+    uint64_t seed;
+    unsigned repeats;
+    size_t size;
+    unsigned max_threads;
+} Options;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static bool same_point(TSPoint a, TSPoint b) {
+    return a.row == b.row && a.column == b.column;
+}
+
+// the same nodes, in the same places
+static bool same_tree(TSNode a, TSNode b) {
+    if (ts_node_symbol(a) != ts_node_symbol(b) ||
+        ts_node_start_byte(a) != ts_node_start_byte(b) ||
+        ts_node_end_byte(a) != ts_node_end_byte(b) ||
+        !same_point(ts_node_start_point(a), ts_node_start_point(b)) ||
+        !same_point(ts_node_end_point(a), ts_node_end_point(b)) ||
+        ts_node_is_missing(a) != ts_node_is_missing(b)) {
+        return false;
+    }
+
+    uint32_t count = ts_node_child_count(a);
+    if (count != ts_node_child_count(b)) return false;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!same_tree(ts_node_child(a, i), ts_node_child(b, i))) return false;
+    }
+    return true;
+}
+
+static bool same_document(const CorpusKind *kind, TSNode root, const TSOrgmodeParallelTree *parallel) {
+    uint32_t count = ts_node_child_count(root);
+    if (count != parallel->section_count) {
+        fprintf(stderr, "%s: %u top level nodes in parallel, but %u in the full parse\n",
+                kind->name, parallel->section_count, count);
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (!same_tree(ts_node_child(root, i), parallel->sections[i])) {
+            fprintf(stderr, "%s: the section at byte %u differs from the full parse\n",
+                    kind->name, ts_node_start_byte(ts_node_child(root, i)));
+            return false;
+        }
+    }
+    return true;
+}
+
+static int run_corpus(const Options *options, const CorpusKind *kind) {
+    Corpus corpus = {0};
+    corpus_generate(&corpus, kind, options->seed, options->size);
+
+    TSParser *parser = ts_parser_new();
+    if (!ts_parser_set_language(parser, tree_sitter_orgmode())) {
+        fprintf(stderr, "%s: incompatible language version\n", kind->name);
+        exit(1);
+    }
+
+    TSTree *full = NULL;
+    double full_ns = 0;
+    for (unsigned i = 0; i < options->repeats; i++) {
+        if (full != NULL) ts_tree_delete(full);
+        double start = now_ns();
+        full = ts_parser_parse_string(parser, NULL, corpus.contents, (uint32_t) corpus.size);
+        double elapsed = now_ns() - start;
+        if (i == 0 || elapsed < full_ns) full_ns = elapsed;
+    }
+    if (full == NULL) {
+        fprintf(stderr, "%s: parse failed\n", kind->name);
+        exit(1);
+    }
+
+    TSNode root = ts_tree_root_node(full);
+    bool checked = !ts_node_has_error(root);
+    int failures = 0;
+
+    for (unsigned threads = 1;; threads = threads * 2 < options->max_threads ? threads * 2 : options->max_threads) {
+        TSOrgmodeParallelTree parallel;
+        double best_ns = 0;
+        bool agrees = true;
+        uint32_t chunks = 0;
+
+        for (unsigned i = 0; i < options->repeats; i++) {
+            double start = now_ns();
+            if (!tree_sitter_orgmode_parse_parallel(&parallel, corpus.contents, corpus.size, threads)) {
+                fprintf(stderr, "%s: parallel parse failed\n", kind->name);
+                exit(1);
+            }
+            double elapsed = now_ns() - start;
+            if (i == 0 || elapsed < best_ns) best_ns = elapsed;
+
+            chunks = parallel.tree_count;
+            if (i == 0 && checked) agrees = same_document(kind, root, &parallel);
+            tree_sitter_orgmode_parallel_tree_delete(&parallel);
+        }
+
+        printf("{\"corpus\":\"%s\",\"seed\":%llu,\"bytes\":%zu,\"threads\":%u,\"chunks\":%u,"
+               "\"full_ns\":%.0f,\"best_ns\":%.0f,\"speedup\":%.2f,\"checked\":%s,\"agrees\":%s}\n",
+               kind->name, (unsigned long long) options->seed, corpus.size, threads, chunks,
+               full_ns, best_ns, full_ns / best_ns, checked ? "true" : "false", agrees ? "true" : "false");
+        fflush(stdout);
+        if (!agrees) failures = 1;
+
+        if (threads >= options->max_threads) break;
+    }
+
+    ts_tree_delete(full);
+    ts_parser_delete(parser);
+    corpus_delete(&corpus);
+    return failures;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [-s seed] [-n repeats] [-b bytes] [-j threads] [-l] [corpus...]\n", program);
+}
+
+int main(int argc, char **argv) {
+    Options options = {DEFAULT_SEED, DEFAULT_REPEATS, 0, tree_sitter_orgmode_cpu_count()};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:b:j:l")) != -1) {
+        switch (opt) {
+            case 's':
+                options.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'n':
+                options.repeats = (unsigned) strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                options.size = strtoull(optarg, NULL, 10);
+                break;
+            case 'j':
+                options.max_threads = (unsigned) strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                for (size_t i = 0; i < corpus_kind_count; i++) {
+                    printf("%-18s %s\n", corpus_kinds[i].name, corpus_kinds[i].description);
+                }
+                return 0;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (options.repeats == 0 || options.max_threads == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int failures = 0;
+    if (optind == argc) {
+        for (size_t i = 0; i < corpus_kind_count; i++) {
+            failures += run_corpus(&options, &corpus_kinds[i]);
+        }
+    } else {
+        for (int i = optind; i < argc; i++) {
+            const CorpusKind *kind = corpus_kind(argv[i]);
+            if (kind == NULL) {
+                fprintf(stderr, "unknown corpus '%s'; -l lists them\n", argv[i]);
+                failures++;
+                continue;
+            }
+            failures += run_corpus(&options, kind);
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,305 @@
+// Throughput benchmarks for the whole parser.
+//
+// Each synthetic corpus (see corpus.c) is generated from the seed and parsed
+// through tree_sitter_orgmode() a few times, in a child process of its own so
+// that its peak RSS is its own. Every corpus reports one JSON object per line
+// with its parse speed, memory, tree size and allocations per parse. When the
+// scanner is built with ORGMODE_SCANNER_STATS, a second line has its counters
+// over all of the corpus's parses.
+//
+//     orgmode-parse-bench [-s seed] [-n repeats] [-b bytes] [-o dir] [-l] [corpus...]
+//
+// -b sets the size of every corpus instead of its default, -o also writes
+// each corpus to dir/<name>.org, and -l lists the corpora.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "corpus.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-orgmode.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SEED 1
+#define DEFAULT_REPEATS 5
+
+typedef struct {
+    uint64_t mallocs;
+    uint64_t reallocs;
+    uint64_t frees;
+} AllocCounts;
+
+static AllocCounts alloc_counts;
+
+static void *counting_malloc(size_t size) {
+    alloc_counts.mallocs++;
+    return malloc(size);
+}
+
+static void *counting_calloc(size_t count, size_t size) {
+    alloc_counts.mallocs++;
+    return calloc(count, size);
+}
+
+static void *counting_realloc(void *ptr, size_t size) {
+    alloc_counts.reallocs++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ptr) {
+    if (ptr != NULL) alloc_counts.frees++;
+    free(ptr);
+}
+
+typedef struct {
+    uint64_t seed;
+    unsigned repeats;
+    size_t size;
+    const char *output_dir;
+} Options;
+
+typedef struct {
+    uint64_t nodes;
+    uint64_t named_nodes;
+} NodeCounts;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+// in KiB, whatever the platform reports it in
+static long peak_rss_kib(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+static NodeCounts count_nodes(TSNode root) {
+    NodeCounts counts = {0, 0};
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+
+    for (;;) {
+        counts.nodes++;
+        if (ts_node_is_named(ts_tree_cursor_current_node(&cursor))) counts.named_nodes++;
+
+        if (ts_tree_cursor_goto_first_child(&cursor)) continue;
+
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ts_tree_cursor_delete(&cursor);
+                return counts;
+            }
+        }
+    }
+}
+
+static void print_scanner_stats(const CorpusKind *kind, unsigned parses) {
+    static TSOrgmodeScannerStats stats;
+    if (!tree_sitter_orgmode_scanner_stats(&stats)) return;
+
+    printf("{\"corpus\":\"%s\",\"parses\":%u,\"scans\":%llu,\"word_fallbacks\":%llu,"
+           "\"bytes_advanced\":%llu,\"bytes_discarded\":%llu,"
+           "\"serializations\":%llu,\"serialized_bytes\":%llu,"
+           "\"deserializations\":%llu,\"deserialized_bytes\":%llu,\"tokens\":{",
+           kind->name, parses,
+           (unsigned long long) stats.scans, (unsigned long long) stats.word_fallbacks,
+           (unsigned long long) stats.bytes_advanced, (unsigned long long) stats.bytes_discarded,
+           (unsigned long long) stats.serializations, (unsigned long long) stats.serialized_bytes,
+           (unsigned long long) stats.deserializations, (unsigned long long) stats.deserialized_bytes);
+
+    bool first = true;
+    for (unsigned i = 0; i < TREE_SITTER_ORGMODE_EXTERNAL_TOKEN_COUNT; i++) {
+        if (stats.tokens[i] == 0) continue;
+        printf("%s\"%s\":%llu", first ? "" : ",",
+               tree_sitter_orgmode_external_token_name(i), (unsigned long long) stats.tokens[i]);
+        first = false;
+    }
+
+    printf("},\"other_valid_set_scans\":%llu,\"valid_sets\":[",
+           (unsigned long long) stats.other_valid_set_scans);
+    for (uint32_t i = 0; i < stats.valid_set_count; i++) {
+        printf("%s{\"valid_tokens\":\"%#llx\",\"scans\":%llu}", i == 0 ? "" : ",",
+               (unsigned long long) stats.valid_sets[i].valid_tokens,
+               (unsigned long long) stats.valid_sets[i].scans);
+    }
+    printf("]}\n");
+}
+
+static bool write_corpus(const Options *options, const CorpusKind *kind, const Corpus *corpus) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s.org", options->output_dir, kind->name);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    bool ok = fwrite(corpus->contents, 1, corpus->size, file) == corpus->size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok) perror(path);
+    return ok;
+}
+
+static int run_corpus(const Options *options, const CorpusKind *kind) {
+    Corpus corpus = {0};
+    corpus_generate(&corpus, kind, options->seed, options->size);
+    if (options->output_dir != NULL && !write_corpus(options, kind, &corpus)) return 1;
+
+    long corpus_rss = peak_rss_kib();
+
+    TSParser *parser = ts_parser_new();
+    if (!ts_parser_set_language(parser, tree_sitter_orgmode())) {
+        fprintf(stderr, "%s: incompatible language version\n", kind->name);
+        return 1;
+    }
+
+    double best_ns = 0, total_ns = 0;
+    AllocCounts allocs = {0, 0, 0};
+    NodeCounts nodes = {0, 0};
+    bool has_error = false;
+
+    tree_sitter_orgmode_scanner_stats_reset();
+    for (unsigned i = 0; i < options->repeats; i++) {
+        memset(&alloc_counts, 0, sizeof(alloc_counts));
+        double start = now_ns();
+        TSTree *tree = ts_parser_parse_string(parser, NULL, corpus.contents, (uint32_t) corpus.size);
+        double elapsed = now_ns() - start;
+
+        if (tree == NULL) {
+            fprintf(stderr, "%s: parse failed\n", kind->name);
+            return 1;
+        }
+
+        // only the parse itself counts, not the walk or the tree's teardown
+        total_ns += elapsed;
+        if (i == 0 || elapsed < best_ns) best_ns = elapsed;
+        allocs.mallocs += alloc_counts.mallocs;
+        allocs.reallocs += alloc_counts.reallocs;
+        allocs.frees += alloc_counts.frees;
+
+        if (i == 0) {
+            TSNode root = ts_tree_root_node(tree);
+            nodes = count_nodes(root);
+            has_error = ts_node_has_error(root);
+        }
+
+        ts_tree_delete(tree);
+    }
+
+    double repeats = options->repeats;
+    printf("{\"corpus\":\"%s\",\"seed\":%llu,\"bytes\":%zu,\"repeats\":%u,"
+           "\"best_ns\":%.0f,\"mean_ns\":%.0f,\"mb_per_s\":%.2f,\"ns_per_byte\":%.3f,"
+           "\"peak_rss_kib\":%ld,\"corpus_rss_kib\":%ld,"
+           "\"nodes\":%llu,\"named_nodes\":%llu,\"has_error\":%s,"
+           "\"mallocs_per_parse\":%.1f,\"reallocs_per_parse\":%.1f,\"frees_per_parse\":%.1f}\n",
+           kind->name, (unsigned long long) options->seed, corpus.size, options->repeats,
+           best_ns, total_ns / repeats, corpus.size / best_ns * 1e3, best_ns / corpus.size,
+           peak_rss_kib(), corpus_rss,
+           (unsigned long long) nodes.nodes, (unsigned long long) nodes.named_nodes,
+           has_error ? "true" : "false",
+           allocs.mallocs / repeats, allocs.reallocs / repeats, allocs.frees / repeats);
+    print_scanner_stats(kind, options->repeats);
+    fflush(stdout);
+
+    ts_parser_delete(parser);
+    corpus_delete(&corpus);
+    return 0;
+}
+
+static int run_isolated(const Options *options, const CorpusKind *kind) {
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) _exit(run_corpus(options, kind));
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0) {
+        perror("waitpid");
+        return 1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s: benchmark failed\n", kind->name);
+        return 1;
+    }
+    return 0;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [-s seed] [-n repeats] [-b bytes] [-o dir] [-l] [corpus...]\n", program);
+}
+
+int main(int argc, char **argv) {
+    Options options = {DEFAULT_SEED, DEFAULT_REPEATS, 0, NULL};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:b:o:l")) != -1) {
+        switch (opt) {
+            case 's':
+                options.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'n':
+                options.repeats = (unsigned) strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                options.size = strtoull(optarg, NULL, 10);
+                break;
+            case 'o':
+                options.output_dir = optarg;
+                break;
+            case 'l':
+                for (size_t i = 0; i < corpus_kind_count; i++) {
+                    printf("%-18s %s\n", corpus_kinds[i].name, corpus_kinds[i].description);
+                }
+                return 0;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (options.repeats == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    ts_set_allocator(counting_malloc, counting_calloc, counting_realloc, counting_free);
+
+    int failures = 0;
+    if (optind == argc) {
+        for (size_t i = 0; i < corpus_kind_count; i++) {
+            failures += run_isolated(&options, &corpus_kinds[i]);
+        }
+    } else {
+        for (int i = optind; i < argc; i++) {
+            const CorpusKind *kind = corpus_kind(argv[i]);
+            if (kind == NULL) {
+                fprintf(stderr, "unknown corpus '%s'; -l lists them\n", argv[i]);
+                failures++;
+                continue;
+            }
+            failures += run_isolated(&options, kind);
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
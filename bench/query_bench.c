@@ -0,0 +1,294 @@
+// How long the highlights, injections and folds queries take to run over
+// large documents, the way an editor runs them.
+//
+// Every synthetic corpus (see corpus.c) is parsed once, then each query is
+// run over the whole document, and over windows of lines spread through it,
+// as a highlighter does for what's on screen. Each corpus and query reports
+// one JSON object per line with the time to compile the query, the time and
+// number of captures for the whole document, and percentiles of the time
+// for a window.
+//
+//     orgmode-query-bench [-s seed] [-b bytes] [-w lines] [-k windows] [-q dir] [-l] [corpus...]
+//
+// -b sets the size of every corpus instead of its default, -w the lines in a
+// window (default 80), -k how many windows (default 200), -q the directory
+// the queries are read from, and -l lists the corpora. The exit status is 1
+// if a query doesn't compile.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "corpus.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-orgmode.h>
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// where `make bench` runs from; CMake passes the source tree's
+#ifndef ORGMODE_QUERIES_DIR
+#define ORGMODE_QUERIES_DIR "queries"
+#endif
+
+#define DEFAULT_SEED 1
+#define DEFAULT_WINDOW_LINES 80
+#define DEFAULT_WINDOWS 200
+
+static const char *const query_names[] = {"highlights", "injections", "folds"};
+
+#define QUERY_COUNT (sizeof(query_names) / sizeof(query_names[0]))
+
+typedef struct {
+    uint64_t seed;
+    size_t size;
+    unsigned window_lines;
+    unsigned windows;
+    const char *queries_dir;
+} Options;
+
+typedef struct {
+    const char *name;
+    char *source;
+    uint32_t length;
+} QueryFile;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static void *checked_realloc(void *ptr, size_t size) {
+    void *result = realloc(ptr, size);
+    if (result == NULL) {
+        fprintf(stderr, "out of memory\n");
+        abort();
+    }
+    return result;
+}
+
+static bool read_query(const char *dir, QueryFile *query) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s.scm", dir, query->name);
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    size_t size = 0, capacity = 4096;
+    query->source = checked_realloc(NULL, capacity);
+    for (size_t read; (read = fread(query->source + size, 1, capacity - size, file)) > 0;) {
+        size += read;
+        if (size == capacity) query->source = checked_realloc(query->source, capacity *= 2);
+    }
+
+    bool ok = !ferror(file);
+    if (!ok) perror(path);
+    fclose(file);
+    query->length = (uint32_t) size;
+    return ok;
+}
+
+static const char *query_error_name(TSQueryError error) {
+    switch (error) {
+        case TSQueryErrorSyntax: return "syntax";
+        case TSQueryErrorNodeType: return "node type";
+        case TSQueryErrorField: return "field";
+        case TSQueryErrorCapture: return "capture";
+        case TSQueryErrorStructure: return "structure";
+        case TSQueryErrorLanguage: return "language";
+        default: return "unknown";
+    }
+}
+
+// runs the query over the cursor's range as a highlighter does, capture by
+// capture in document order, and returns how many captures there were
+static uint64_t run_query(TSQueryCursor *cursor, const TSQuery *query, TSNode root) {
+    uint64_t captures = 0;
+    TSQueryMatch match;
+    uint32_t capture_index;
+    ts_query_cursor_exec(cursor, query, root);
+    while (ts_query_cursor_next_capture(cursor, &match, &capture_index)) captures++;
+    return captures;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static double percentile(const double *sorted, unsigned count, double p) {
+    unsigned rank = (unsigned) ceil(p * count);
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+// the byte each line starts at, and one past the last for the end
+static uint32_t *line_starts(const Corpus *corpus, uint32_t *count) {
+    uint32_t capacity = 1024, n = 0;
+    uint32_t *starts = checked_realloc(NULL, capacity * sizeof(uint32_t));
+    starts[n++] = 0;
+    for (const char *p = corpus->contents, *end = p + corpus->size;
+         (p = memchr(p, '\n', (size_t) (end - p))) != NULL; p++) {
+        if (n == capacity) starts = checked_realloc(starts, (capacity *= 2) * sizeof(uint32_t));
+        starts[n++] = (uint32_t) (p - corpus->contents) + 1;
+    }
+    *count = n;
+    return starts;
+}
+
+static int run_corpus(const Options *options, const CorpusKind *kind, const QueryFile *files) {
+    Corpus corpus = {0};
+    corpus_generate(&corpus, kind, options->seed, options->size);
+
+    TSParser *parser = ts_parser_new();
+    if (!ts_parser_set_language(parser, tree_sitter_orgmode())) {
+        fprintf(stderr, "%s: incompatible language version\n", kind->name);
+        exit(1);
+    }
+    TSTree *tree = ts_parser_parse_string(parser, NULL, corpus.contents, (uint32_t) corpus.size);
+    if (tree == NULL) {
+        fprintf(stderr, "%s: parse failed\n", kind->name);
+        exit(1);
+    }
+    TSNode root = ts_tree_root_node(tree);
+
+    uint32_t lines;
+    uint32_t *starts = line_starts(&corpus, &lines);
+    double *window_ns = checked_realloc(NULL, (options->windows > 0 ? options->windows : 1) * sizeof(double));
+    TSQueryCursor *cursor = ts_query_cursor_new();
+
+    int failures = 0;
+    for (size_t i = 0; i < QUERY_COUNT; i++) {
+        uint32_t error_offset;
+        TSQueryError error;
+        double start = now_ns();
+        TSQuery *query = ts_query_new(tree_sitter_orgmode(), files[i].source, files[i].length,
+                                      &error_offset, &error);
+        double compile_ns = now_ns() - start;
+        if (query == NULL) {
+            fprintf(stderr, "%s.scm: %s error at byte %u\n", files[i].name, query_error_name(error), error_offset);
+            failures++;
+            continue;
+        }
+
+        ts_query_cursor_set_byte_range(cursor, 0, UINT32_MAX);
+        start = now_ns();
+        uint64_t captures = run_query(cursor, query, root);
+        double full_ns = now_ns() - start;
+        bool exceeded = ts_query_cursor_did_exceed_match_limit(cursor);
+
+        // windows from the start of the document to the end
+        uint64_t window_captures = 0;
+        for (unsigned w = 0; w < options->windows; w++) {
+            uint32_t first = (uint32_t) ((uint64_t) w * lines / options->windows);
+            uint32_t last = first + options->window_lines < lines ? first + options->window_lines : lines - 1;
+            ts_query_cursor_set_byte_range(cursor, starts[first], starts[last]);
+            start = now_ns();
+            window_captures += run_query(cursor, query, root);
+            window_ns[w] = now_ns() - start;
+            exceeded |= ts_query_cursor_did_exceed_match_limit(cursor);
+        }
+        qsort(window_ns, options->windows, sizeof(double), compare_doubles);
+
+        printf("{\"corpus\":\"%s\",\"seed\":%llu,\"bytes\":%zu,\"query\":\"%s\",\"patterns\":%u,"
+               "\"compile_us\":%.1f,\"full_ms\":%.2f,\"captures\":%llu,\"full_mb_per_s\":%.1f",
+               kind->name, (unsigned long long) options->seed, corpus.size, files[i].name,
+               ts_query_pattern_count(query), compile_ns / 1e3, full_ns / 1e6,
+               (unsigned long long) captures, corpus.size / full_ns * 1e3);
+        if (options->windows > 0) {
+            printf(",\"window_lines\":%u,\"windows\":%u,\"window_p50_us\":%.1f,\"window_p99_us\":%.1f,"
+                   "\"window_max_us\":%.1f,\"window_captures\":%.1f",
+                   options->window_lines, options->windows,
+                   percentile(window_ns, options->windows, 0.5) / 1e3,
+                   percentile(window_ns, options->windows, 0.99) / 1e3,
+                   window_ns[options->windows - 1] / 1e3,
+                   (double) window_captures / options->windows);
+        }
+        printf(",\"exceeded_match_limit\":%s}\n", exceeded ? "true" : "false");
+        fflush(stdout);
+        ts_query_delete(query);
+    }
+
+    ts_query_cursor_delete(cursor);
+    free(window_ns);
+    free(starts);
+    ts_tree_delete(tree);
+    ts_parser_delete(parser);
+    corpus_delete(&corpus);
+    return failures;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [-s seed] [-b bytes] [-w lines] [-k windows] [-q dir] [-l] [corpus...]\n", program);
+}
+
+int main(int argc, char **argv) {
+    Options options = {DEFAULT_SEED, 0, DEFAULT_WINDOW_LINES, DEFAULT_WINDOWS, ORGMODE_QUERIES_DIR};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:b:w:k:q:l")) != -1) {
+        switch (opt) {
+            case 's':
+                options.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'b':
+                options.size = strtoull(optarg, NULL, 10);
+                break;
+            case 'w':
+                options.window_lines = (unsigned) strtoul(optarg, NULL, 10);
+                break;
+            case 'k':
+                options.windows = (unsigned) strtoul(optarg, NULL, 10);
+                break;
+            case 'q':
+                options.queries_dir = optarg;
+                break;
+            case 'l':
+                for (size_t i = 0; i < corpus_kind_count; i++) {
+                    printf("%-18s %s\n", corpus_kinds[i].name, corpus_kinds[i].description);
+                }
+                return 0;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (options.window_lines == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    QueryFile files[QUERY_COUNT];
+    for (size_t i = 0; i < QUERY_COUNT; i++) {
+        files[i] = (QueryFile) {query_names[i], NULL, 0};
+        if (!read_query(options.queries_dir, &files[i])) return 1;
+    }
+
+    int failures = 0;
+    if (optind == argc) {
+        for (size_t i = 0; i < corpus_kind_count; i++) {
+            failures += run_corpus(&options, &corpus_kinds[i], files);
+        }
+    } else {
+        for (int i = optind; i < argc; i++) {
+            const CorpusKind *kind = corpus_kind(argv[i]);
+            if (kind == NULL) {
+                fprintf(stderr, "unknown corpus '%s'; -l lists them\n", argv[i]);
+                failures++;
+                continue;
+            }
+            failures += run_corpus(&options, kind, files);
+        }
+    }
+
+    for (size_t i = 0; i < QUERY_COUNT; i++) free(files[i].source);
+    return failures == 0 ? 0 : 1;
+}
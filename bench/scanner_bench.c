@@ -0,0 +1,474 @@
+// Microbenchmarks for the external scanner.
+//
+// scanner.c is compiled straight into this program and driven by a mock
+// lexer over in-memory strings, so neither the generated parser nor the
+// tree-sitter runtime is needed. Every case reports its timing, the number
+// of allocations and lexer callbacks it made per operation, and the size of
+// the serialized scanner state it leaves behind, as one JSON object per line.
+//
+//     orgmode-scanner-bench [iterations] [case...]
+
+#define _POSIX_C_SOURCE 200809L
+#define TREE_SITTER_REUSE_ALLOCATOR
+
+#include "scanner.c"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_ITERATIONS 1000000
+
+static struct {
+    uint64_t mallocs;
+    uint64_t reallocs;
+    uint64_t frees;
+} alloc_counts;
+
+static void *counting_malloc(size_t size) {
+    alloc_counts.mallocs++;
+    return malloc(size);
+}
+
+static void *counting_calloc(size_t count, size_t size) {
+    alloc_counts.mallocs++;
+    return calloc(count, size);
+}
+
+static void *counting_realloc(void *ptr, size_t size) {
+    alloc_counts.reallocs++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ptr) {
+    if (ptr != NULL) alloc_counts.frees++;
+    free(ptr);
+}
+
+void *(*ts_current_malloc)(size_t) = counting_malloc;
+void *(*ts_current_calloc)(size_t, size_t) = counting_calloc;
+void *(*ts_current_realloc)(void *, size_t) = counting_realloc;
+void (*ts_current_free)(void *) = counting_free;
+
+typedef struct {
+    TSLexer lexer;
+    const char *input;
+    uint32_t length;
+    uint32_t position;
+    uint32_t column; // of the start of the input
+    uint32_t end;
+    uint64_t calls; // callbacks made by the scanner, kept across resets
+} MockLexer;
+
+static void mock_advance(TSLexer *lexer, bool skip) {
+    MockLexer *m = (MockLexer*) lexer;
+    (void) skip;
+
+    m->calls++;
+
+    if (m->position >= m->length) return;
+
+    m->position++;
+    lexer->lookahead = m->position < m->length
+        ? (unsigned char) m->input[m->position] : 0;
+}
+
+static void mock_mark_end(TSLexer *lexer) {
+    MockLexer *m = (MockLexer*) lexer;
+    m->calls++;
+    m->end = m->position;
+}
+
+// like the runtime's, this goes back to the start of the line and counts its
+// way forward again, so it takes time in proportion to the column. the part
+// of the line before the input, if it starts partway through one, is counted
+// over as if it were there.
+static uint32_t mock_get_column(TSLexer *lexer) {
+    MockLexer *m = (MockLexer*) lexer;
+    m->calls++;
+
+    uint32_t line_start = m->position;
+    while (line_start > 0 && m->input[line_start - 1] != '\n') line_start--;
+
+    volatile uint32_t column = 0;
+    if (line_start == 0) {
+        for (uint32_t i = 0; i < m->column; i++) column++;
+    }
+    for (uint32_t i = line_start; i < m->position; i++) {
+        (void) ((volatile const char*) m->input)[i];
+        column++;
+    }
+    return column;
+}
+
+static bool mock_is_at_included_range_start(const TSLexer *lexer) {
+    (void) lexer;
+    return false;
+}
+
+static bool mock_eof(const TSLexer *lexer) {
+    MockLexer *m = (MockLexer*) lexer;
+    m->calls++;
+    return m->position >= m->length;
+}
+
+static void mock_log(const TSLexer *lexer, const char *fmt, ...) {
+    (void) lexer;
+    (void) fmt;
+}
+
+static void mock_init(MockLexer *m) {
+    memset(m, 0, sizeof(*m));
+    m->lexer.advance = mock_advance;
+    m->lexer.mark_end = mock_mark_end;
+    m->lexer.get_column = mock_get_column;
+    m->lexer.is_at_included_range_start = mock_is_at_included_range_start;
+    m->lexer.eof = mock_eof;
+    m->lexer.log = mock_log;
+}
+
+static void mock_reset(MockLexer *m, const char *input, uint32_t column) {
+    m->input = input;
+    m->length = strlen(input);
+    m->position = 0;
+    m->column = column;
+    m->end = 0;
+    m->lexer.lookahead = m->length > 0 ? (unsigned char) m->input[0] : 0;
+}
+
+// Runs one scan of `input`, starting at `column`, with exactly the given
+// tokens valid, and aborts unless `expected` is what comes out.
+static void scan_expect(
+    void *scanner,
+    MockLexer *m,
+    const char *input,
+    uint32_t column,
+    enum TokenType expected,
+    const enum TokenType *valid,
+    unsigned valid_count
+) {
+    bool valid_symbols[ERROR_SENTINEL + 1] = {false};
+    for (unsigned i = 0; i < valid_count; i++) {
+        valid_symbols[valid[i]] = true;
+    }
+
+    mock_reset(m, input, column);
+
+    bool ok = tree_sitter_orgmode_external_scanner_scan(scanner, &m->lexer, valid_symbols);
+    if (!ok || m->lexer.result_symbol != expected) {
+        fprintf(stderr, "scanning '%s': expected token %d, got %d (ok=%d)\n",
+                input, expected, m->lexer.result_symbol, ok);
+        exit(1);
+    }
+}
+
+#define SCAN(input, column, expected, ...) \
+    scan_expect(s, m, (input), (column), (expected), \
+                (const enum TokenType[]){__VA_ARGS__}, \
+                sizeof((const enum TokenType[]){__VA_ARGS__}) / sizeof(enum TokenType))
+
+typedef struct {
+    const char *name;
+    void (*setup)(void *s, MockLexer *m);
+    void (*run)(void *s, MockLexer *m);
+    unsigned ops; // number of scans, or other operations, in each call to run
+} BenchCase;
+
+// what the parser allows at the start of a line in a section's body, and
+// partway through a paragraph
+#define MID_LINE_TOKENS \
+    NEWLINE, WORD, BOLD_START, ITALIC_START, UNDERLINE_START, VERBATIM_START, \
+    CODE_INLINE_START, STRIKETHROUGH_START, LINK_START
+#define LINE_START_TOKENS \
+    MID_LINE_TOKENS, STARS, END_SECTION, LIST_START, DRAWER_NAME, KEYWORD_KEY, \
+    BLOCK_BEGIN_MARKER, COMMENT_LINE
+
+static void setup_section(void *s, MockLexer *m) {
+    SCAN("* heading", 0, STARS, STARS);
+}
+
+static void run_newline(void *s, MockLexer *m) {
+    SCAN("\n", 12, NEWLINE, MID_LINE_TOKENS);
+}
+
+static void run_word_line_start(void *s, MockLexer *m) {
+    SCAN("paragraph", 0, WORD, LINE_START_TOKENS);
+}
+
+static void run_word_mid_line(void *s, MockLexer *m) {
+    SCAN("paragraph", 12, WORD, MID_LINE_TOKENS);
+}
+
+static void run_stars(void *s, MockLexer *m) {
+    SCAN("** heading", 0, STARS, LINE_START_TOKENS);
+    SCAN("** heading", 0, END_SECTION, LINE_START_TOKENS);
+}
+
+static void run_list(void *s, MockLexer *m) {
+    SCAN("- item", 0, LIST_START, LINE_START_TOKENS);
+    SCAN("paragraph", 0, LIST_END, LINE_START_TOKENS, BULLET, LIST_END);
+}
+
+static void run_keyword(void *s, MockLexer *m) {
+    SCAN("#+title: notes", 0, KEYWORD_KEY, LINE_START_TOKENS);
+}
+
+static void run_block_begin_marker(void *s, MockLexer *m) {
+    SCAN("#+begin_src", 0, BLOCK_BEGIN_MARKER, LINE_START_TOKENS);
+}
+
+// forty lines of code, full of characters that would otherwise start markup
+#define SRC_LINE "    if (*p == '/' && p[1] == '*') return strip_comment(p + 2, \"=~+_\");\n"
+#define SRC_LINES_8 SRC_LINE SRC_LINE SRC_LINE SRC_LINE SRC_LINE SRC_LINE SRC_LINE SRC_LINE
+#define SRC_BODY SRC_LINES_8 SRC_LINES_8 SRC_LINES_8 SRC_LINES_8 SRC_LINES_8 "  #+end_src\n"
+
+static void setup_src_block(void *s, MockLexer *m) {
+    setup_section(s, m);
+    SCAN("src", 8, BLOCK_BEGIN_NAME, BLOCK_BEGIN_NAME);
+}
+
+static void run_raw_body(void *s, MockLexer *m) {
+    SCAN(SRC_BODY, 0, RAW_BODY, LINE_START_TOKENS, RAW_BODY, BLOCK_END_MARKER);
+}
+
+static void run_comment(void *s, MockLexer *m) {
+    SCAN("# a comment", 0, COMMENT_LINE, LINE_START_TOKENS);
+}
+
+static void run_bold(void *s, MockLexer *m) {
+    SCAN("*bold", 12, BOLD_START, MID_LINE_TOKENS);
+    SCAN("* text", 17, BOLD_END, MID_LINE_TOKENS, BOLD_END);
+}
+
+static void run_link(void *s, MockLexer *m) {
+    SCAN("[[target", 12, LINK_START, MID_LINE_TOKENS);
+    SCAN("]]", 20, LINK_END, MID_LINE_TOKENS, LINK_END);
+}
+
+static void setup_property_drawer(void *s, MockLexer *m) {
+    SCAN(":properties:", 0, DRAWER_NAME, DRAWER_NAME);
+}
+
+static void run_property_name(void *s, MockLexer *m) {
+    SCAN(":CUSTOM_ID:", 0, PROPERTY_NAME, PROPERTY_NAME, DRAWER_END, WORD);
+}
+
+static void run_drawer_name(void *s, MockLexer *m) {
+    SCAN(":logbook:", 0, DRAWER_NAME, DRAWER_NAME);
+    SCAN(":end:", 0, DRAWER_END, DRAWER_NAME, DRAWER_END);
+}
+
+static void run_block_name(void *s, MockLexer *m) {
+    SCAN("src", 8, BLOCK_BEGIN_NAME, BLOCK_BEGIN_NAME);
+    SCAN("src", 6, BLOCK_END_NAME, BLOCK_END_NAME);
+}
+
+#define LONG_NAME \
+    "a-block-name-that-is-much-longer-than-any-inline-buffer-would-be-sized-for-" \
+    "and-keeps-going-for-a-while-longer"
+
+static void run_long_block_name(void *s, MockLexer *m) {
+    SCAN(LONG_NAME, 8, BLOCK_BEGIN_NAME, BLOCK_BEGIN_NAME);
+    SCAN(LONG_NAME, 6, BLOCK_END_NAME, BLOCK_END_NAME);
+}
+
+static void run_word(void *s, MockLexer *m) {
+    SCAN("incrementally-reparsed_paragraphs", 0, WORD, WORD, BOLD_START, ITALIC_START, LINK_START);
+}
+
+// a word inside every kind of markup, which it must not run past the end of
+static void setup_deep_markup(void *s, MockLexer *m) {
+    SCAN("*a", 0, BOLD_START, BOLD_START);
+    SCAN("/a", 1, ITALIC_START, ITALIC_START);
+    SCAN("_a", 2, UNDERLINE_START, UNDERLINE_START);
+    SCAN("=a", 3, VERBATIM_START, VERBATIM_START);
+    SCAN("~a", 4, CODE_INLINE_START, CODE_INLINE_START);
+    SCAN("+a", 5, STRIKETHROUGH_START, STRIKETHROUGH_START);
+    SCAN("[a", 6, LINK_START, LINK_START);
+}
+
+// the state tree-sitter hands back to the scanner is a serialized copy of
+// its own, so a round trip is a serialize followed by a deserialize.
+static void run_state_round_trip(void *s, MockLexer *m) {
+    static char buffer[TREE_SITTER_SERIALIZATION_BUFFER_SIZE];
+    unsigned length = tree_sitter_orgmode_external_scanner_serialize(s, buffer);
+    tree_sitter_orgmode_external_scanner_deserialize(s, buffer, length);
+}
+
+// a level 2 heading after a 24 level deep outline, which closes all but its
+// first section before it can start its own. between every scan, the state
+// makes the round trip it does in the runtime.
+#define CASCADE_DEPTH 24
+
+static void run_close_sections(void *payload, MockLexer *m) {
+    Scanner *s = (Scanner*) payload;
+    array_clear(&s->section_level);
+    for (unsigned char level = 1; level <= CASCADE_DEPTH; level++) {
+        array_push(&s->section_level, level);
+    }
+
+    for (unsigned i = 2; i <= CASCADE_DEPTH; i++) {
+        SCAN("** heading", 0, END_SECTION, LINE_START_TOKENS);
+        run_state_round_trip(s, m);
+    }
+    SCAN("** heading", 0, STARS, LINE_START_TOKENS);
+    run_state_round_trip(s, m);
+}
+
+// a paragraph at column 4 after a list nested 16 deep, which closes every
+// list but the outermost
+#define CASCADE_LISTS 16
+
+static void run_close_lists(void *payload, MockLexer *m) {
+    Scanner *s = (Scanner*) payload;
+    array_clear(&s->list_indents);
+    for (unsigned char i = 0; i <= CASCADE_LISTS; i++) {
+        array_push(&s->list_indents, i * 4);
+    }
+
+    for (unsigned i = 0; i < CASCADE_LISTS; i++) {
+        SCAN("paragraph", 4, LIST_END, LINE_START_TOKENS, BULLET, LIST_END);
+        run_state_round_trip(s, m);
+    }
+    SCAN("paragraph", 4, WORD, LINE_START_TOKENS, BULLET, LIST_END);
+    run_state_round_trip(s, m);
+}
+
+// inside a src block, in a list, under a third level heading
+static void setup_typical_state(void *payload, MockLexer *m) {
+    Scanner *s = (Scanner*) payload;
+    for (unsigned char level = 1; level <= 3; level++) {
+        array_push(&s->section_level, level);
+    }
+    array_push(&s->list_indents, 0);
+    array_push(&s->list_indents, 2);
+    array_push(&s->markup_stack, BOLD_START);
+    array_push(&s->block_name_stack, BLOCK_SRC);
+}
+
+// a deep outline, with nested lists, drawers, markup and blocks, some of
+// which have custom names
+static void setup_deep_state(void *payload, MockLexer *m) {
+    Scanner *s = (Scanner*) payload;
+    for (unsigned char level = 1; level <= 8; level++) {
+        array_push(&s->section_level, level);
+    }
+    for (unsigned char indent = 0; indent < 12; indent += 2) {
+        array_push(&s->list_indents, indent);
+    }
+    array_push(&s->drawer_stack, NORMAL_DRAWER);
+    array_push(&s->drawer_stack, PROPERTY_DRAWER);
+    for (unsigned i = 0; i < 4; i++) {
+        array_push(&s->markup_stack, markup_begins[i]);
+    }
+    array_push(&s->block_name_stack, BLOCK_QUOTE);
+    array_push(&s->block_name_stack, intern_block_name(s, "notes", 5));
+    array_push(&s->block_name_stack, BLOCK_EXAMPLE);
+    array_push(&s->block_name_stack, intern_block_name(s, "aside", 5));
+}
+
+// a bullet indented by n spaces, in a list at that indent. since the mock's
+// get_column costs what the runtime's does, these show how the cost of a scan
+// grows with the indentation.
+#define INDENTED_BULLET(n) \
+    static char indented_bullet_##n[n + sizeof("- item")]; \
+    static void setup_indented_list_##n(void *payload, MockLexer *m) { \
+        Scanner *s = (Scanner*) payload; \
+        memset(indented_bullet_##n, ' ', n); \
+        memcpy(indented_bullet_##n + n, "- item", sizeof("- item")); \
+        array_push(&s->list_indents, n); \
+    } \
+    static void run_indented_bullet_##n(void *s, MockLexer *m) { \
+        SCAN(indented_bullet_##n, 0, BULLET, LINE_START_TOKENS, BULLET, LIST_END); \
+    }
+
+INDENTED_BULLET(4)
+INDENTED_BULLET(16)
+INDENTED_BULLET(64)
+INDENTED_BULLET(240)
+
+static const BenchCase cases[] = {
+    {"property_name", setup_property_drawer, run_property_name, 1},
+    {"drawer_name", NULL, run_drawer_name, 2},
+    {"block_name", NULL, run_block_name, 2},
+    {"long_block_name", NULL, run_long_block_name, 2},
+    {"word", NULL, run_word, 1},
+    {"word_in_deep_markup", setup_deep_markup, run_word, 1},
+    {"token_newline", setup_section, run_newline, 1},
+    {"token_word_line_start", setup_section, run_word_line_start, 1},
+    {"token_word_mid_line", setup_section, run_word_mid_line, 1},
+    {"token_stars", setup_section, run_stars, 2},
+    {"token_list", setup_section, run_list, 2},
+    {"token_keyword", setup_section, run_keyword, 1},
+    {"token_block_begin_marker", setup_section, run_block_begin_marker, 1},
+    {"token_comment", setup_section, run_comment, 1},
+    {"token_raw_body", setup_src_block, run_raw_body, 1},
+    {"bullet_indent_4", setup_indented_list_4, run_indented_bullet_4, 1},
+    {"bullet_indent_16", setup_indented_list_16, run_indented_bullet_16, 1},
+    {"bullet_indent_64", setup_indented_list_64, run_indented_bullet_64, 1},
+    {"bullet_indent_240", setup_indented_list_240, run_indented_bullet_240, 1},
+    {"close_sections_24", NULL, run_close_sections, CASCADE_DEPTH},
+    {"close_lists_16", NULL, run_close_lists, CASCADE_LISTS + 1},
+    {"token_bold", setup_section, run_bold, 2},
+    {"token_link", setup_section, run_link, 2},
+    {"state_round_trip_empty", NULL, run_state_round_trip, 1},
+    {"state_round_trip_typical", setup_typical_state, run_state_round_trip, 1},
+    {"state_round_trip_deep", setup_deep_state, run_state_round_trip, 1},
+};
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static void run_case(const BenchCase *c, unsigned long iterations) {
+    MockLexer lexer;
+    mock_init(&lexer);
+
+    void *s = tree_sitter_orgmode_external_scanner_create();
+    if (c->setup != NULL) c->setup(s, &lexer);
+
+    // warm up, so one-off growth of the scanner's buffers isn't counted
+    for (unsigned i = 0; i < 16; i++) c->run(s, &lexer);
+
+    memset(&alloc_counts, 0, sizeof(alloc_counts));
+    lexer.calls = 0;
+    double start = now_ns();
+    for (unsigned long i = 0; i < iterations; i++) c->run(s, &lexer);
+    double elapsed = now_ns() - start;
+
+    char state[TREE_SITTER_SERIALIZATION_BUFFER_SIZE];
+    unsigned state_bytes = tree_sitter_orgmode_external_scanner_serialize(s, state);
+
+    double ops = (double) iterations * c->ops;
+    printf("{\"case\":\"%s\",\"ops\":%.0f,\"ns_per_op\":%.2f,"
+           "\"mallocs_per_op\":%.3f,\"reallocs_per_op\":%.3f,\"frees_per_op\":%.3f,"
+           "\"lexer_calls_per_op\":%.2f,\"state_bytes\":%u}\n",
+           c->name, ops, elapsed / ops,
+           alloc_counts.mallocs / ops,
+           alloc_counts.reallocs / ops,
+           alloc_counts.frees / ops,
+           lexer.calls / ops,
+           state_bytes);
+
+    tree_sitter_orgmode_external_scanner_destroy(s);
+}
+
+int main(int argc, char **argv) {
+    unsigned long iterations = DEFAULT_ITERATIONS;
+    if (argc > 1) iterations = strtoul(argv[1], NULL, 10);
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        bool selected = argc <= 2;
+        for (int j = 2; j < argc; j++) {
+            if (strcmp(argv[j], cases[i].name) == 0) selected = true;
+        }
+        if (selected) run_case(&cases[i], iterations);
+    }
+
+    return 0;
+}
@@ -0,0 +1,216 @@
+// Opening a document as a skeleton of its headings, and then parsing only the
+// sections that are asked for, against parsing all of it.
+//
+// Every synthetic corpus (see corpus.c) is parsed in full once. Then it's
+// opened the cheap way, by outlining it and parsing only its heading lines,
+// and a spread of its sections are parsed one at a time. Each reports one
+// JSON object per line with the times and tree sizes of both ways, and
+// whether every section parsed on its own came out the same as in the full
+// tree, down to the positions of its nodes.
+//
+//     orgmode-section-bench [-s seed] [-b bytes] [-k sections] [-l] [corpus...]
+//
+// -b sets the size of every corpus instead of its default, -k how many
+// sections to parse (default 16), and -l lists the corpora. The exit status
+// is 1 if any section differs from the full parse.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "corpus.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-orgmode-runtime.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SEED 1
+#define DEFAULT_SECTIONS 16
+
+typedef struct {
+    uint64_t seed;
+    size_t size;
+    unsigned sections;
+} Options;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static bool same_point(TSPoint a, TSPoint b) {
+    return a.row == b.row && a.column == b.column;
+}
+
+// the same nodes, in the same places
+static bool same_tree(TSNode a, TSNode b) {
+    if (ts_node_symbol(a) != ts_node_symbol(b) ||
+        ts_node_start_byte(a) != ts_node_start_byte(b) ||
+        ts_node_end_byte(a) != ts_node_end_byte(b) ||
+        !same_point(ts_node_start_point(a), ts_node_start_point(b)) ||
+        !same_point(ts_node_end_point(a), ts_node_end_point(b)) ||
+        ts_node_is_missing(a) != ts_node_is_missing(b)) {
+        return false;
+    }
+
+    uint32_t count = ts_node_child_count(a);
+    if (count != ts_node_child_count(b)) return false;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!same_tree(ts_node_child(a, i), ts_node_child(b, i))) return false;
+    }
+    return true;
+}
+
+static void report_difference(const CorpusKind *kind, TSNode full, TSNode section) {
+    char *expected = ts_node_string(full);
+    char *got = ts_node_is_null(section) ? NULL : ts_node_string(section);
+    fprintf(stderr, "%s: the section at byte %u differs from the full parse\n  full: %.200s\n  alone: %.200s\n",
+            kind->name, ts_node_start_byte(full), expected, got ? got : "nothing");
+    free(expected);
+    free(got);
+}
+
+static int run_corpus(const Options *options, const CorpusKind *kind) {
+    Corpus corpus = {0};
+    corpus_generate(&corpus, kind, options->seed, options->size);
+
+    TSParser *parser = ts_parser_new();
+    if (!ts_parser_set_language(parser, tree_sitter_orgmode())) {
+        fprintf(stderr, "%s: incompatible language version\n", kind->name);
+        exit(1);
+    }
+
+    double start = now_ns();
+    TSTree *full = ts_parser_parse_string(parser, NULL, corpus.contents, (uint32_t) corpus.size);
+    double full_ns = now_ns() - start;
+
+    TSOrgmodeOutline outline = {NULL, 0, 0};
+    start = now_ns();
+    bool indexed = tree_sitter_orgmode_outline(&outline, corpus.contents, corpus.size);
+    TSTree *skeleton = indexed
+        ? tree_sitter_orgmode_parse_headings(parser, corpus.contents, corpus.size, &outline) : NULL;
+    double open_ns = now_ns() - start;
+
+    if (full == NULL || skeleton == NULL) {
+        fprintf(stderr, "%s: parse failed\n", kind->name);
+        exit(1);
+    }
+
+    uint32_t headings = 0;
+    for (uint32_t i = 0; i < outline.count; i++) {
+        if (outline.entries[i].kind == TS_ORGMODE_OUTLINE_HEADING) headings++;
+    }
+
+    // a spread of sections from the start of the document to the end
+    unsigned wanted = options->sections < headings ? options->sections : headings;
+    unsigned parsed = 0, skipped = 0, differ = 0;
+    uint64_t section_nodes = 0;
+    double section_ns = 0;
+    for (uint32_t i = 0, seen = 0, next = 0; i < outline.count && parsed + skipped < wanted; i++) {
+        if (outline.entries[i].kind != TS_ORGMODE_OUTLINE_HEADING) continue;
+        if (seen++ != next) continue;
+        next = (uint32_t) ((uint64_t) (parsed + skipped + 1) * headings / wanted);
+
+        uint32_t start_byte = outline.entries[i].start_byte;
+        start = now_ns();
+        TSTree *tree = tree_sitter_orgmode_parse_section(parser, corpus.contents, corpus.size, &outline, i);
+        section_ns += now_ns() - start;
+        if (tree == NULL) {
+            fprintf(stderr, "%s: parse failed\n", kind->name);
+            exit(1);
+        }
+
+        // there's nothing to compare with where the full parse's error
+        // recovery didn't make this heading a section of its own
+        TSNode expected = tree_sitter_orgmode_section_node(full, start_byte);
+        TSNode got = tree_sitter_orgmode_section_node(tree, start_byte);
+        if (ts_node_is_null(expected) || ts_node_has_error(expected)) {
+            skipped++;
+        } else {
+            parsed++;
+            section_nodes += ts_node_descendant_count(ts_tree_root_node(tree));
+            if (ts_node_is_null(got) || !same_tree(expected, got)) {
+                if (differ++ == 0) report_difference(kind, expected, got);
+            }
+        }
+        ts_tree_delete(tree);
+    }
+
+    printf("{\"corpus\":\"%s\",\"seed\":%llu,\"bytes\":%zu,\"headings\":%u,"
+           "\"full_ns\":%.0f,\"full_nodes\":%u,\"open_ns\":%.0f,\"skeleton_nodes\":%u,"
+           "\"sections\":%u,\"skipped\":%u,\"section_ns\":%.0f,\"section_nodes\":%.1f,\"differ\":%u}\n",
+           kind->name, (unsigned long long) options->seed, corpus.size, headings,
+           full_ns, ts_node_descendant_count(ts_tree_root_node(full)),
+           open_ns, ts_node_descendant_count(ts_tree_root_node(skeleton)),
+           parsed, skipped, parsed + skipped ? section_ns / (parsed + skipped) : 0,
+           parsed ? (double) section_nodes / parsed : 0, differ);
+    fflush(stdout);
+
+    ts_tree_delete(skeleton);
+    ts_tree_delete(full);
+    ts_parser_delete(parser);
+    tree_sitter_orgmode_outline_delete(&outline);
+    corpus_delete(&corpus);
+    return differ == 0 ? 0 : 1;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [-s seed] [-b bytes] [-k sections] [-l] [corpus...]\n", program);
+}
+
+int main(int argc, char **argv) {
+    Options options = {DEFAULT_SEED, 0, DEFAULT_SECTIONS};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:b:k:l")) != -1) {
+        switch (opt) {
+            case 's':
+                options.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'b':
+                options.size = strtoull(optarg, NULL, 10);
+                break;
+            case 'k':
+                options.sections = (unsigned) strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                for (size_t i = 0; i < corpus_kind_count; i++) {
+                    printf("%-18s %s\n", corpus_kinds[i].name, corpus_kinds[i].description);
+                }
+                return 0;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (options.sections == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int failures = 0;
+    if (optind == argc) {
+        for (size_t i = 0; i < corpus_kind_count; i++) {
+            failures += run_corpus(&options, &corpus_kinds[i]);
+        }
+    } else {
+        for (int i = optind; i < argc; i++) {
+            const CorpusKind *kind = corpus_kind(argv[i]);
+            if (kind == NULL) {
+                fprintf(stderr, "unknown corpus '%s'; -l lists them\n", argv[i]);
+                failures++;
+                continue;
+            }
+            failures += run_corpus(&options, kind);
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
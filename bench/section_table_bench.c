@@ -0,0 +1,389 @@
+// Reading the sections of a parsed document into a TSOrgmodeSections table,
+// against the node by node walk a binding would otherwise make, and keeping
+// the table up to date through incremental reparses.
+//
+// Every synthetic corpus (see corpus.c) is parsed, and its sections read both
+// ways. Then headings picked at random are typed in, and demoted and promoted
+// again, and after each edit and reparse the table is updated from the one
+// before and checked against filling it afresh. Each corpus reports one JSON
+// object per line with the times of all of these.
+//
+//     orgmode-section-table-bench [-s seed] [-b bytes] [-n edits] [-l] [corpus...]
+//
+// -b sets the size of every corpus instead of its default, -n the number of
+// edits (default 100), and -l lists the corpora. The exit status is 1 if the
+// two ways of reading a document disagree, or an update differs from a fresh
+// fill.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "corpus.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-orgmode-runtime.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SEED 1
+#define DEFAULT_EDITS 100
+#define REPEATS 5
+
+typedef struct {
+    uint64_t seed;
+    size_t size;
+    unsigned edits;
+} Options;
+
+// a section as the node by node walk finds it
+typedef struct {
+    uint32_t level;
+    uint32_t start_byte;
+    uint32_t end_byte;
+    uint32_t title_start;
+    uint32_t title_end;
+    uint32_t parent;
+    uint8_t todo;
+    uint8_t priority;
+} Row;
+
+typedef struct {
+    Row *rows;
+    uint32_t count;
+    uint32_t capacity;
+    const char *text;
+    TSSymbol section;
+    TSSymbol keyword;
+    TSSymbol cookie;
+    TSFieldId title;
+} Walk;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static uint64_t next_random(uint64_t *rng) {
+    uint64_t z = (*rng += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static void *checked_realloc(void *ptr, size_t size) {
+    void *result = realloc(ptr, size);
+    if (result == NULL) {
+        fprintf(stderr, "out of memory\n");
+        abort();
+    }
+    return result;
+}
+
+static void reserve(TSOrgmodeSections *sections, uint32_t capacity) {
+    if (!tree_sitter_orgmode_sections_reserve(sections, capacity)) {
+        fprintf(stderr, "out of memory\n");
+        abort();
+    }
+}
+
+// the walk a binding makes through the node API, a call or more per node
+static void walk_nodes(Walk *walk, TSNode node, uint32_t parent) {
+    for (uint32_t i = 0, n = ts_node_child_count(node); i < n; i++) {
+        TSNode child = ts_node_child(node, i);
+        if (ts_node_symbol(child) != walk->section) continue;
+
+        if (walk->count == walk->capacity) {
+            walk->capacity = walk->capacity < 64 ? 64 : walk->capacity * 2;
+            walk->rows = checked_realloc(walk->rows, walk->capacity * sizeof(Row));
+        }
+        uint32_t index = walk->count++;
+        Row *row = &walk->rows[index];
+        *row = (Row) {
+            .start_byte = ts_node_start_byte(child),
+            .end_byte = ts_node_end_byte(child),
+            .parent = parent,
+        };
+        row->title_start = row->title_end = row->start_byte;
+
+        TSNode heading = ts_node_child(child, 0);
+        TSNode stars = ts_node_child(heading, 0);
+        row->level = ts_node_end_byte(stars) - ts_node_start_byte(stars);
+        for (uint32_t j = 1, m = ts_node_child_count(heading); j < m; j++) {
+            TSNode part = ts_node_child(heading, j);
+            TSSymbol symbol = ts_node_symbol(part);
+            if (symbol == walk->keyword) {
+                row->todo = walk->text[ts_node_start_byte(part)] == 'D' ? TS_ORGMODE_TODO_DONE : TS_ORGMODE_TODO_TODO;
+            } else if (symbol == walk->cookie) {
+                row->priority = (uint8_t) walk->text[ts_node_start_byte(part) + 2];
+            }
+        }
+        TSNode title = ts_node_child_by_field_id(heading, walk->title);
+        if (!ts_node_is_null(title)) {
+            row->title_start = ts_node_start_byte(title);
+            row->title_end = ts_node_end_byte(title);
+        }
+
+        walk_nodes(walk, child, index);
+    }
+}
+
+static void walk_tree(Walk *walk, const TSTree *tree) {
+    walk->count = 0;
+    walk_nodes(walk, ts_tree_root_node(tree), TS_ORGMODE_NO_SECTION);
+}
+
+static bool same_as_walk(const TSOrgmodeSections *sections, const Walk *walk) {
+    if (sections->count != walk->count) return false;
+    for (uint32_t i = 0; i < walk->count; i++) {
+        const Row *row = &walk->rows[i];
+        if (sections->levels[i] != row->level ||
+            sections->start_bytes[i] != row->start_byte ||
+            sections->end_bytes[i] != row->end_byte ||
+            sections->title_starts[i] != row->title_start ||
+            sections->title_ends[i] != row->title_end ||
+            sections->parents[i] != row->parent ||
+            sections->todos[i] != row->todo ||
+            sections->priorities[i] != row->priority) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool same_sections(const TSOrgmodeSections *a, const TSOrgmodeSections *b) {
+    if (a->count != b->count) return false;
+    size_t wide = a->count * sizeof(uint32_t);
+    return memcmp(a->levels, b->levels, wide) == 0 &&
+           memcmp(a->start_bytes, b->start_bytes, wide) == 0 &&
+           memcmp(a->end_bytes, b->end_bytes, wide) == 0 &&
+           memcmp(a->title_starts, b->title_starts, wide) == 0 &&
+           memcmp(a->title_ends, b->title_ends, wide) == 0 &&
+           memcmp(a->parents, b->parents, wide) == 0 &&
+           memcmp(a->todos, b->todos, a->count) == 0 &&
+           memcmp(a->priorities, b->priorities, a->count) == 0;
+}
+
+static TSPoint point_at(const Corpus *corpus, uint32_t byte) {
+    TSPoint point = {0, 0};
+    uint32_t line_start = 0;
+    const char *text = corpus->contents;
+
+    for (const char *newline; (newline = memchr(text + line_start, '\n', byte - line_start)) != NULL;) {
+        point.row++;
+        line_start = (uint32_t) (newline - text) + 1;
+    }
+
+    point.column = byte - line_start;
+    return point;
+}
+
+// replaces `removed` bytes at `start` with `text`, which has no newlines,
+// and describes the edit
+static TSInputEdit corpus_replace(Corpus *corpus, uint32_t start, uint32_t removed, const char *text) {
+    uint32_t inserted = (uint32_t) strlen(text);
+    TSInputEdit edit = {
+        .start_byte = start,
+        .old_end_byte = start + removed,
+        .new_end_byte = start + inserted,
+        .start_point = point_at(corpus, start),
+        .old_end_point = point_at(corpus, start + removed),
+    };
+    edit.new_end_point = edit.start_point;
+    edit.new_end_point.column += inserted;
+
+    if (corpus->size - removed + inserted > corpus->capacity) {
+        corpus->capacity = (corpus->size - removed + inserted) * 2;
+        corpus->contents = checked_realloc(corpus->contents, corpus->capacity);
+    }
+
+    memmove(corpus->contents + start + inserted,
+            corpus->contents + start + removed,
+            corpus->size - start - removed);
+    memcpy(corpus->contents + start, text, inserted);
+    corpus->size = corpus->size - removed + inserted;
+    return edit;
+}
+
+static int run_corpus(const Options *options, const CorpusKind *kind) {
+    Corpus corpus = {0};
+    corpus_generate(&corpus, kind, options->seed, options->size);
+
+    TSParser *parser = ts_parser_new();
+    if (!ts_parser_set_language(parser, tree_sitter_orgmode())) {
+        fprintf(stderr, "%s: incompatible language version\n", kind->name);
+        exit(1);
+    }
+
+    TSTree *tree = ts_parser_parse_string(parser, NULL, corpus.contents, (uint32_t) corpus.size);
+    if (tree == NULL) {
+        fprintf(stderr, "%s: parse failed\n", kind->name);
+        exit(1);
+    }
+
+    const TSLanguage *language = tree_sitter_orgmode();
+    Walk walk = {
+        .text = corpus.contents,
+        .section = ts_language_symbol_for_name(language, "section", 7, true),
+        .keyword = ts_language_symbol_for_name(language, "keyword", 7, false),
+        .cookie = ts_language_symbol_for_name(language, "cookie", 6, false),
+        .title = ts_language_field_id_for_name(language, "title", 5),
+    };
+
+    // the best of a few runs of each, once the buffers have grown
+    TSOrgmodeSections current = {0}, next = {0}, fresh = {0};
+    if (!tree_sitter_orgmode_sections(&current, tree, corpus.contents)) reserve(&current, current.count);
+    double walk_ns = 0, table_ns = 0;
+    for (unsigned i = 0; i < REPEATS; i++) {
+        double start = now_ns();
+        walk_tree(&walk, tree);
+        double elapsed = now_ns() - start;
+        if (i == 0 || elapsed < walk_ns) walk_ns = elapsed;
+
+        start = now_ns();
+        tree_sitter_orgmode_sections(&current, tree, corpus.contents);
+        elapsed = now_ns() - start;
+        if (i == 0 || elapsed < table_ns) table_ns = elapsed;
+    }
+
+    unsigned differ = 0;
+    if (!same_as_walk(&current, &walk)) {
+        fprintf(stderr, "%s: the section table differs from the node walk\n", kind->name);
+        differ++;
+    }
+    uint32_t sections = current.count;
+
+    // edits at headings picked from the table, which is kept up to date
+    uint64_t rng = options->seed;
+    unsigned edits = 0;
+    uint32_t demoted = 0;
+    double update_ns = 0, fill_ns = 0;
+    while (edits < options->edits && current.count > 0 && differ == 0) {
+        uint32_t i = (uint32_t) (next_random(&rng) % current.count);
+        TSInputEdit edit;
+        if (edits % 3 == 0) {
+            // a keystroke at the end of the heading's line
+            const char *line = corpus.contents + current.start_bytes[i];
+            const char *newline = memchr(line, '\n', corpus.size - current.start_bytes[i]);
+            uint32_t end = newline == NULL ? (uint32_t) corpus.size : (uint32_t) (newline - corpus.contents);
+            edit = corpus_replace(&corpus, end, 0, "x");
+        } else if (edits % 3 == 1) {
+            demoted = i;
+            edit = corpus_replace(&corpus, current.start_bytes[i], 0, "*");
+        } else {
+            // and promoted back
+            edit = corpus_replace(&corpus, current.start_bytes[demoted], 1, "");
+        }
+
+        ts_tree_edit(tree, &edit);
+        TSTree *reparsed = ts_parser_parse_string(parser, tree, corpus.contents, (uint32_t) corpus.size);
+        if (reparsed == NULL) {
+            fprintf(stderr, "%s: parse failed\n", kind->name);
+            exit(1);
+        }
+        uint32_t range_count;
+        TSRange *ranges = ts_tree_get_changed_ranges(tree, reparsed, &range_count);
+
+        double start = now_ns();
+        if (!tree_sitter_orgmode_sections_update(&next, &current, &edit, reparsed, ranges, range_count,
+                                                 corpus.contents)) {
+            reserve(&next, next.count);
+            start = now_ns();
+            tree_sitter_orgmode_sections_update(&next, &current, &edit, reparsed, ranges, range_count,
+                                                corpus.contents);
+        }
+        update_ns += now_ns() - start;
+
+        start = now_ns();
+        if (!tree_sitter_orgmode_sections(&fresh, reparsed, corpus.contents)) {
+            reserve(&fresh, fresh.count);
+            start = now_ns();
+            tree_sitter_orgmode_sections(&fresh, reparsed, corpus.contents);
+        }
+        fill_ns += now_ns() - start;
+
+        if (!same_sections(&next, &fresh)) {
+            fprintf(stderr, "%s: the update after editing byte %u differs from a fresh fill\n",
+                    kind->name, edit.start_byte);
+            differ++;
+        }
+
+        free(ranges);
+        ts_tree_delete(tree);
+        tree = reparsed;
+        TSOrgmodeSections swap = current;
+        current = next;
+        next = swap;
+        edits++;
+    }
+
+    printf("{\"corpus\":\"%s\",\"seed\":%llu,\"bytes\":%zu,\"sections\":%u,"
+           "\"walk_ns\":%.0f,\"table_ns\":%.0f,\"edits\":%u,\"update_ns\":%.0f,\"fill_ns\":%.0f,\"differ\":%u}\n",
+           kind->name, (unsigned long long) options->seed, corpus.size, sections,
+           walk_ns, table_ns, edits, edits ? update_ns / edits : 0, edits ? fill_ns / edits : 0, differ);
+    fflush(stdout);
+
+    tree_sitter_orgmode_sections_delete(&current);
+    tree_sitter_orgmode_sections_delete(&next);
+    tree_sitter_orgmode_sections_delete(&fresh);
+    free(walk.rows);
+    ts_tree_delete(tree);
+    ts_parser_delete(parser);
+    corpus_delete(&corpus);
+    return differ == 0 ? 0 : 1;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [-s seed] [-b bytes] [-n edits] [-l] [corpus...]\n", program);
+}
+
+int main(int argc, char **argv) {
+    Options options = {DEFAULT_SEED, 0, DEFAULT_EDITS};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:b:n:l")) != -1) {
+        switch (opt) {
+            case 's':
+                options.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'b':
+                options.size = strtoull(optarg, NULL, 10);
+                break;
+            case 'n':
+                options.edits = (unsigned) strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                for (size_t i = 0; i < corpus_kind_count; i++) {
+                    printf("%-18s %s\n", corpus_kinds[i].name, corpus_kinds[i].description);
+                }
+                return 0;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    int failures = 0;
+    if (optind == argc) {
+        for (size_t i = 0; i < corpus_kind_count; i++) {
+            failures += run_corpus(&options, &corpus_kinds[i]);
+        }
+    } else {
+        for (int i = optind; i < argc; i++) {
+            const CorpusKind *kind = corpus_kind(argv[i]);
+            if (kind == NULL) {
+                fprintf(stderr, "unknown corpus '%s'; -l lists them\n", argv[i]);
+                failures++;
+                continue;
+            }
+            failures += run_corpus(&options, kind);
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
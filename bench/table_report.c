@@ -0,0 +1,172 @@
+// How big the generated parse tables are, and a check that they haven't
+// grown past a budget.
+//
+// parser.c is compiled into this rather than linked, so the sizes are the
+// tables' own, from sizeof, whichever compiler and flags built the library.
+// They're printed as one JSON object: the state and symbol counts, the bytes
+// of each table, and table_bytes, their total.
+//
+//     orgmode-table-report [-b budget] [-u budget]
+//
+// -b reads a budget file of "name value" lines, naming any of the numbers
+// reported, and exits 1 if any of them is over. A missing file is an error,
+// like an unreadable one, so a check with no budget never passes. -u writes
+// the current states, large_states and table_bytes to the file as the new
+// budget, for when a grammar change is meant to grow them, or has shrunk
+// them.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "parser.c"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    const char *name;
+    uint64_t value;
+} Size;
+
+// everything reported; the budget can name any of them
+static Size sizes[] = {
+    {"states", STATE_COUNT},
+    {"large_states", LARGE_STATE_COUNT},
+    {"symbols", SYMBOL_COUNT},
+    {"production_ids", PRODUCTION_ID_COUNT},
+    {"parse_table_bytes", sizeof(ts_parse_table)},
+#if LARGE_STATE_COUNT < STATE_COUNT
+    {"small_parse_table_bytes", sizeof(ts_small_parse_table) + sizeof(ts_small_parse_table_map)},
+#else
+    {"small_parse_table_bytes", 0},
+#endif
+    {"parse_actions_bytes", sizeof(ts_parse_actions)},
+    {"lex_modes_bytes", sizeof(ts_lex_modes)},
+    {"primary_state_ids_bytes", sizeof(ts_primary_state_ids)},
+    {"alias_sequences_bytes", sizeof(ts_alias_sequences)},
+#if EXTERNAL_TOKEN_COUNT > 0
+    {"external_scanner_states_bytes", sizeof(ts_external_scanner_states)},
+#else
+    {"external_scanner_states_bytes", 0},
+#endif
+    {"table_bytes", 0},
+};
+
+#define SIZE_COUNT (sizeof(sizes) / sizeof(sizes[0]))
+
+// what -u records
+static const char *const budgeted[] = {"states", "large_states", "table_bytes"};
+
+static Size *find_size(const char *name) {
+    for (size_t i = 0; i < SIZE_COUNT; i++) {
+        if (strcmp(sizes[i].name, name) == 0) return &sizes[i];
+    }
+    return NULL;
+}
+
+static void total_sizes(void) {
+    Size *total = find_size("table_bytes");
+    for (size_t i = 0; i < SIZE_COUNT; i++) {
+        size_t length = strlen(sizes[i].name);
+        if (&sizes[i] != total && length > 6 && strcmp(sizes[i].name + length - 6, "_bytes") == 0) {
+            total->value += sizes[i].value;
+        }
+    }
+}
+
+// 0 if everything's within the budget, 1 if not, 2 if it can't be read
+static int check_budget(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "no budget in %s to check against; -u records one\n", path);
+        return 2;
+    }
+
+    int result = 0;
+    unsigned line_number = 0;
+    char line[256], name[128];
+    unsigned long long limit;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') continue;
+        if (sscanf(line, "%127s %llu", name, &limit) != 2) {
+            fprintf(stderr, "%s:%u: expected a name and a number\n", path, line_number);
+            result = 2;
+            break;
+        }
+
+        Size *size = find_size(name);
+        if (size == NULL) {
+            fprintf(stderr, "%s:%u: nothing called '%s' is reported\n", path, line_number, name);
+            result = 2;
+            break;
+        }
+        if (size->value > limit) {
+            fprintf(stderr, "%s is %llu, over the budget of %llu in %s\n",
+                    name, (unsigned long long) size->value, limit, path);
+            result = 1;
+        } else if (size->value < limit) {
+            fprintf(stderr, "%s is %llu, under the budget of %llu; -u lowers it\n",
+                    name, (unsigned long long) size->value, limit);
+        }
+    }
+
+    fclose(file);
+    return result;
+}
+
+static bool update_budget(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    fprintf(file, "# the most the generated parse tables may grow to; see bench/table_report.c\n");
+    for (size_t i = 0; i < sizeof(budgeted) / sizeof(budgeted[0]); i++) {
+        fprintf(file, "%s %llu\n", budgeted[i], (unsigned long long) find_size(budgeted[i])->value);
+    }
+    bool ok = fclose(file) == 0;
+    if (!ok) perror(path);
+    return ok;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [-b budget] [-u budget]\n", program);
+}
+
+int main(int argc, char **argv) {
+    const char *check = NULL, *update = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:u:")) != -1) {
+        switch (opt) {
+            case 'b':
+                check = optarg;
+                break;
+            case 'u':
+                update = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (optind != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    total_sizes();
+    printf("{");
+    for (size_t i = 0; i < SIZE_COUNT; i++) {
+        printf("%s\"%s\":%llu", i == 0 ? "" : ",", sizes[i].name, (unsigned long long) sizes[i].value);
+    }
+    printf("}\n");
+    fflush(stdout);
+
+    if (update != NULL && !update_budget(update)) return 2;
+    return check != NULL ? check_budget(check) : 0;
+}
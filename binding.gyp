@@ -7,10 +7,25 @@
       ],
       "include_dirs": [
         "src",
+        "bindings/c",
+        "vendor/tree-sitter/lib/include",
       ],
       "sources": [
         "bindings/node/binding.cc",
         "src/parser.c",
+        # the rest of what the C header declares
+        "src/outline.c",
+        "src/sections.c",
+        "src/parallel.c",
+        "src/input.c",
+        "src/section_table.c",
+        # the runtime parseFile and parseBuffer parse with, which `make
+        # vendor` fetches
+        "vendor/tree-sitter/lib/src/lib.c",
+      ],
+      "defines": [
+        # for the runtime's use of POSIX and BSD functions under c11
+        "_DEFAULT_SOURCE",
       ],
       "variables": {
         "has_scanner": "<!(node -p \"fs.existsSync('src/scanner.c')\")"
@@ -22,6 +37,10 @@
         ["OS!='win'", {
           "cflags_c": [
             "-std=c11",
+            "-pthread",
+          ],
+          "ldflags": [
+            "-pthread",
           ],
         }, { # OS == "win"
           "cflags_c": [
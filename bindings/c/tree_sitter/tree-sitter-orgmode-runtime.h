@@ -0,0 +1,449 @@
+#ifndef TREE_SITTER_ORGMODE_RUNTIME_H_
+#define TREE_SITTER_ORGMODE_RUNTIME_H_
+
+// What needs the tree-sitter runtime: parsing the ranges and chunks in
+// tree-sitter-orgmode.h, TSInputs for its mapped and streamed files, and
+// filling its section tables from a tree. The library doesn't link against
+// the runtime, so these are static inline, for programs which do to include
+// in place of tree-sitter-orgmode.h.
+
+#include <tree_sitter/api.h>
+
+#include "tree-sitter-orgmode.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// parses `text` with the parser limited to `lines`, and leaves it parsing
+// whole documents again after
+static inline TSTree *tree_sitter_orgmode_parse_lines(
+    TSParser *parser,
+    const char *text,
+    size_t length,
+    const TSOrgmodeLineRange *lines,
+    uint32_t count
+) {
+    if (length > UINT32_MAX) return NULL;
+
+    // no ranges would mean the whole document, so nothing is an empty range
+    TSRange *ranges = (TSRange *) calloc(count > 0 ? count : 1, sizeof(TSRange));
+    if (ranges == NULL) return NULL;
+    for (uint32_t i = 0; i < count; i++) {
+        ranges[i].start_byte = lines[i].start_byte;
+        ranges[i].start_point.row = lines[i].start_row;
+        ranges[i].end_byte = lines[i].end_byte;
+        ranges[i].end_point.row = lines[i].end_row;
+        ranges[i].end_point.column = lines[i].end_byte == UINT32_MAX ? UINT32_MAX : 0;
+    }
+
+    TSTree *tree = NULL;
+    if (ts_parser_set_included_ranges(parser, ranges, count > 0 ? count : 1)) {
+        tree = ts_parser_parse_string(parser, NULL, text, (uint32_t) length);
+    }
+    ts_parser_set_included_ranges(parser, NULL, 0);
+    free(ranges);
+    return tree;
+}
+
+// A tree of the document's sections with their headings but without their
+// bodies. A heading in it ends at the end of its line, where in a full parse
+// it would take in the blank lines after it too.
+static inline TSTree *tree_sitter_orgmode_parse_headings(
+    TSParser *parser,
+    const char *text,
+    size_t length,
+    const TSOrgmodeOutline *outline
+) {
+    uint32_t count = tree_sitter_orgmode_heading_ranges(outline, NULL, 0);
+    TSOrgmodeLineRange *lines = (TSOrgmodeLineRange *) malloc((count > 0 ? count : 1) * sizeof(TSOrgmodeLineRange));
+    if (lines == NULL) return NULL;
+    tree_sitter_orgmode_heading_ranges(outline, lines, count);
+    TSTree *tree = tree_sitter_orgmode_parse_lines(parser, text, length, lines, count);
+    free(lines);
+    return tree;
+}
+
+// A tree of the section headed by outline->entries[heading], inside
+// sections holding only the headings it's nested under. Returns NULL if the
+// entry isn't a heading. tree_sitter_orgmode_section_node finds the section.
+static inline TSTree *tree_sitter_orgmode_parse_section(
+    TSParser *parser,
+    const char *text,
+    size_t length,
+    const TSOrgmodeOutline *outline,
+    uint32_t heading
+) {
+    TSOrgmodeLineRange buffer[16];
+    TSOrgmodeLineRange *lines = buffer;
+    uint32_t count = tree_sitter_orgmode_section_ranges(outline, heading, buffer, 16);
+    if (count == 0) return NULL;
+    if (count > 16) {
+        lines = (TSOrgmodeLineRange *) malloc(count * sizeof(TSOrgmodeLineRange));
+        if (lines == NULL) return NULL;
+        tree_sitter_orgmode_section_ranges(outline, heading, lines, count);
+    }
+
+    TSTree *tree = tree_sitter_orgmode_parse_lines(parser, text, length, lines, count);
+    if (lines != buffer) free(lines);
+    return tree;
+}
+
+// the section starting at `start_byte`, or a null node if there's none
+static inline TSNode tree_sitter_orgmode_section_node(const TSTree *tree, uint32_t start_byte) {
+    TSNode node = ts_tree_root_node(tree);
+    for (;;) {
+        node = ts_node_first_child_for_byte(node, start_byte);
+        if (ts_node_is_null(node) || ts_node_start_byte(node) > start_byte) break;
+        if (ts_node_start_byte(node) == start_byte && strcmp(ts_node_type(node), "section") == 0) return node;
+    }
+    TSNode null_node;
+    memset(&null_node, 0, sizeof(null_node));
+    return null_node;
+}
+
+// A document parsed in chunks by tree_sitter_orgmode_parse_parallel. Its
+// nodes keep their places in the whole text.
+typedef struct {
+    TSTree **trees; // one for each chunk, in order
+    uint32_t tree_count;
+    // the top level of the document, across every chunk: the body before the
+    // first heading if there's one, then each level 1 section
+    TSNode *sections;
+    uint32_t section_count;
+} TSOrgmodeParallelTree;
+
+typedef struct {
+    const char *text;
+    size_t length;
+    const TSOrgmodeLineRange *chunks;
+    TSParser **parsers; // one for each thread, made by the thread
+    TSTree **trees;
+} TSOrgmodeChunkParse;
+
+static inline void tree_sitter_orgmode_parse_chunk(void *context, unsigned worker, uint32_t chunk) {
+    TSOrgmodeChunkParse *parse = (TSOrgmodeChunkParse *) context;
+    if (parse->parsers[worker] == NULL) {
+        TSParser *parser = ts_parser_new();
+        if (!ts_parser_set_language(parser, tree_sitter_orgmode())) {
+            ts_parser_delete(parser);
+            return;
+        }
+        parse->parsers[worker] = parser;
+    }
+    parse->trees[chunk] = tree_sitter_orgmode_parse_lines(
+        parse->parsers[worker], parse->text, parse->length, &parse->chunks[chunk], 1);
+}
+
+static inline void tree_sitter_orgmode_parallel_tree_delete(TSOrgmodeParallelTree *result) {
+    for (uint32_t i = 0; i < result->tree_count; i++) {
+        if (result->trees[i] != NULL) ts_tree_delete(result->trees[i]);
+    }
+    free(result->trees);
+    free(result->sections);
+    memset(result, 0, sizeof(*result));
+}
+
+// Parses `text` on `threads` threads, or one for each CPU if it's 0, each
+// with a parser of its own. The document is split at level 1 headings into a
+// few chunks for each thread, which come out as they would in a full parse
+// as long as it has no errors; error recovery can't reach past a chunk.
+// Returns false, with `result` empty, if a chunk couldn't be parsed.
+static inline bool tree_sitter_orgmode_parse_parallel(
+    TSOrgmodeParallelTree *result,
+    const char *text,
+    size_t length,
+    unsigned threads
+) {
+    memset(result, 0, sizeof(*result));
+    if (threads == 0) threads = tree_sitter_orgmode_cpu_count();
+
+    TSOrgmodeOutline outline = {NULL, 0, 0};
+    if (!tree_sitter_orgmode_outline(&outline, text, length)) {
+        tree_sitter_orgmode_outline_delete(&outline);
+        return false;
+    }
+
+    uint32_t max_chunks = threads > 1 ? 4 * threads : 1;
+    uint32_t count = tree_sitter_orgmode_split(&outline, length, max_chunks, NULL, 0);
+    TSOrgmodeLineRange *chunks = (TSOrgmodeLineRange *) malloc(count * sizeof(TSOrgmodeLineRange));
+    TSParser **parsers = (TSParser **) calloc(threads, sizeof(TSParser *));
+    result->trees = (TSTree **) calloc(count, sizeof(TSTree *));
+    result->tree_count = result->trees != NULL ? count : 0;
+
+    bool ok = chunks != NULL && parsers != NULL && result->trees != NULL;
+    if (ok) {
+        tree_sitter_orgmode_split(&outline, length, max_chunks, chunks, count);
+        TSOrgmodeChunkParse parse = {text, length, chunks, parsers, result->trees};
+        ok = tree_sitter_orgmode_run_parallel(threads, count, tree_sitter_orgmode_parse_chunk, &parse);
+    }
+
+    uint32_t sections = 0;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        if (result->trees[i] == NULL) ok = false;
+        else sections += ts_node_child_count(ts_tree_root_node(result->trees[i]));
+    }
+
+    if (ok) {
+        result->sections = (TSNode *) malloc((sections > 0 ? sections : 1) * sizeof(TSNode));
+        ok = result->sections != NULL;
+    }
+    for (uint32_t i = 0; ok && i < count; i++) {
+        TSNode root = ts_tree_root_node(result->trees[i]);
+        for (uint32_t j = 0, n = ts_node_child_count(root); j < n; j++) {
+            result->sections[result->section_count++] = ts_node_child(root, j);
+        }
+    }
+
+    for (unsigned i = 0; parsers != NULL && i < threads; i++) {
+        if (parsers[i] != NULL) ts_parser_delete(parsers[i]);
+    }
+    free(parsers);
+    free(chunks);
+    tree_sitter_orgmode_outline_delete(&outline);
+
+    if (!ok) tree_sitter_orgmode_parallel_tree_delete(result);
+    return ok;
+}
+
+static inline const char *tree_sitter_orgmode_mapped_input_read(
+    void *payload,
+    uint32_t byte_index,
+    TSPoint position,
+    uint32_t *bytes_read
+) {
+    (void) position;
+    return tree_sitter_orgmode_mapped_file_read(payload, byte_index, bytes_read);
+}
+
+static inline const char *tree_sitter_orgmode_stream_input_read(
+    void *payload,
+    uint32_t byte_index,
+    TSPoint position,
+    uint32_t *bytes_read
+) {
+    (void) position;
+    return tree_sitter_orgmode_file_stream_read(payload, byte_index, bytes_read);
+}
+
+// an input for ts_parser_parse reading from a mapped file, which has to stay
+// mapped for as long as the parse goes on
+static inline TSInput tree_sitter_orgmode_mapped_input(TSOrgmodeMappedFile *file) {
+    TSInput input;
+    memset(&input, 0, sizeof(input));
+    input.payload = file;
+    input.read = tree_sitter_orgmode_mapped_input_read;
+    input.encoding = TSInputEncodingUTF8;
+    return input;
+}
+
+// an input for ts_parser_parse streaming from a file descriptor. check
+// stream->failed once it's parsed.
+static inline TSInput tree_sitter_orgmode_stream_input(TSOrgmodeFileStream *stream) {
+    TSInput input;
+    memset(&input, 0, sizeof(input));
+    input.payload = stream;
+    input.read = tree_sitter_orgmode_stream_input_read;
+    input.encoding = TSInputEncodingUTF8;
+    return input;
+}
+
+typedef struct {
+    TSOrgmodeSections *sections;
+    // the sections before the edit, or NULL to walk every section
+    const TSOrgmodeSections *previous;
+    const char *text;
+    TSSymbol section;
+    TSSymbol keyword;
+    TSSymbol cookie;
+    TSFieldId title;
+    // what the edit and the reparse changed, in the new tree's bytes
+    const TSRange *changed;
+    uint32_t changed_count;
+    uint32_t edit_start;
+    uint32_t edit_old_end;
+    uint32_t edit_new_end;
+} TSOrgmodeSectionWalk;
+
+// the cursor is on a section; reads its heading, leaving the cursor there
+static inline void tree_sitter_orgmode_read_section(
+    TSOrgmodeSectionWalk *walk,
+    TSTreeCursor *cursor,
+    uint32_t parent
+) {
+    TSOrgmodeSections *sections = walk->sections;
+    uint32_t i = sections->count++;
+    if (i >= sections->capacity) return;
+
+    TSNode section = ts_tree_cursor_current_node(cursor);
+    uint32_t start = ts_node_start_byte(section);
+    sections->levels[i] = 0;
+    sections->start_bytes[i] = start;
+    sections->end_bytes[i] = ts_node_end_byte(section);
+    sections->title_starts[i] = start;
+    sections->title_ends[i] = start;
+    sections->parents[i] = parent;
+    sections->todos[i] = TS_ORGMODE_TODO_NONE;
+    sections->priorities[i] = 0;
+
+    // the heading, and then its stars
+    if (!ts_tree_cursor_goto_first_child(cursor)) return;
+    if (ts_tree_cursor_goto_first_child(cursor)) {
+        TSNode stars = ts_tree_cursor_current_node(cursor);
+        sections->levels[i] = ts_node_end_byte(stars) - ts_node_start_byte(stars);
+
+        while (ts_tree_cursor_goto_next_sibling(cursor)) {
+            TSNode node = ts_tree_cursor_current_node(cursor);
+            TSSymbol symbol = ts_node_symbol(node);
+            if (symbol == walk->keyword) {
+                sections->todos[i] = walk->text[ts_node_start_byte(node)] == 'D'
+                    ? TS_ORGMODE_TODO_DONE
+                    : TS_ORGMODE_TODO_TODO;
+            } else if (symbol == walk->cookie) {
+                sections->priorities[i] = (uint8_t) walk->text[ts_node_start_byte(node) + 2];
+            } else if (walk->title != 0 && ts_tree_cursor_current_field_id(cursor) == walk->title) {
+                sections->title_starts[i] = ts_node_start_byte(node);
+                sections->title_ends[i] = ts_node_end_byte(node);
+            }
+        }
+        ts_tree_cursor_goto_parent(cursor);
+    }
+    ts_tree_cursor_goto_parent(cursor);
+}
+
+// Copies `section`, and every section in it, from before the edit if
+// neither the edit nor the reparse changed any of it, moving them along by
+// however much the edit moved them. Returns false if it has to be walked.
+static inline bool tree_sitter_orgmode_copy_sections(
+    TSOrgmodeSectionWalk *walk,
+    TSNode section,
+    uint32_t parent
+) {
+    const TSOrgmodeSections *previous = walk->previous;
+    if (previous == NULL) return false;
+
+    uint32_t start = ts_node_start_byte(section);
+    uint32_t end = ts_node_end_byte(section);
+    if (start <= walk->edit_new_end && walk->edit_start <= end) return false;
+    for (uint32_t i = 0; i < walk->changed_count; i++) {
+        if (start <= walk->changed[i].end_byte && walk->changed[i].start_byte <= end) return false;
+    }
+
+    // anything after the edit has moved by the difference in its length
+    int64_t shift = start > walk->edit_new_end ? (int64_t) walk->edit_new_end - walk->edit_old_end : 0;
+    uint32_t old_start = (uint32_t) (start - shift);
+    uint32_t low = 0, high = previous->count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (previous->start_bytes[middle] < old_start) low = middle + 1;
+        else high = middle;
+    }
+    uint32_t from = low;
+    if (from == previous->count || previous->start_bytes[from] != old_start ||
+        previous->end_bytes[from] != (uint32_t) (end - shift)) {
+        return false;
+    }
+
+    // the sections in it are the ones after it which start before it ends
+    uint32_t to = from + 1;
+    while (to < previous->count && previous->start_bytes[to] < previous->end_bytes[from]) to++;
+
+    TSOrgmodeSections *sections = walk->sections;
+    uint32_t at = sections->count;
+    sections->count += to - from;
+    for (uint32_t i = from; i < to && at + (i - from) < sections->capacity; i++) {
+        uint32_t j = at + (i - from);
+        sections->levels[j] = previous->levels[i];
+        sections->start_bytes[j] = (uint32_t) (previous->start_bytes[i] + shift);
+        sections->end_bytes[j] = (uint32_t) (previous->end_bytes[i] + shift);
+        sections->title_starts[j] = (uint32_t) (previous->title_starts[i] + shift);
+        sections->title_ends[j] = (uint32_t) (previous->title_ends[i] + shift);
+        sections->parents[j] = i == from ? parent : previous->parents[i] - from + at;
+        sections->todos[j] = previous->todos[i];
+        sections->priorities[j] = previous->priorities[i];
+    }
+    return true;
+}
+
+// the cursor is on the document or a section; adds the sections in it,
+// leaving the cursor where it was. sections are only ever in those two.
+static inline void tree_sitter_orgmode_walk_sections(
+    TSOrgmodeSectionWalk *walk,
+    TSTreeCursor *cursor,
+    uint32_t parent
+) {
+    if (!ts_tree_cursor_goto_first_child(cursor)) return;
+    do {
+        TSNode node = ts_tree_cursor_current_node(cursor);
+        if (ts_node_symbol(node) != walk->section) continue;
+        if (tree_sitter_orgmode_copy_sections(walk, node, parent)) continue;
+
+        uint32_t index = walk->sections->count;
+        tree_sitter_orgmode_read_section(walk, cursor, parent);
+        tree_sitter_orgmode_walk_sections(walk, cursor, index);
+    } while (ts_tree_cursor_goto_next_sibling(cursor));
+    ts_tree_cursor_goto_parent(cursor);
+}
+
+static inline bool tree_sitter_orgmode_run_section_walk(TSOrgmodeSectionWalk *walk, const TSTree *tree) {
+    const TSLanguage *language = tree_sitter_orgmode();
+    walk->section = ts_language_symbol_for_name(language, "section", 7, true);
+    walk->keyword = ts_language_symbol_for_name(language, "keyword", 7, false);
+    walk->cookie = ts_language_symbol_for_name(language, "cookie", 6, false);
+    walk->title = ts_language_field_id_for_name(language, "title", 5);
+
+    walk->sections->count = 0;
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+    tree_sitter_orgmode_walk_sections(walk, &cursor, TS_ORGMODE_NO_SECTION);
+    ts_tree_cursor_delete(&cursor);
+    return walk->sections->count <= walk->sections->capacity;
+}
+
+// Fills `sections` with the sections of `tree`, parsed from `text`, in one
+// walk of a tree cursor which only goes into the document, sections and
+// headings. Returns false if there wasn't room for them all; reserve
+// sections->count and call it again.
+static inline bool tree_sitter_orgmode_sections(
+    TSOrgmodeSections *sections,
+    const TSTree *tree,
+    const char *text
+) {
+    TSOrgmodeSectionWalk walk;
+    memset(&walk, 0, sizeof(walk));
+    walk.sections = sections;
+    walk.text = text;
+    return tree_sitter_orgmode_run_section_walk(&walk, tree);
+}
+
+// Fills `sections` with the sections of `tree`, the incremental reparse of a
+// tree that was given `edit`, from `previous`, the sections of that tree
+// before the edit. Only the sections overlapping the edit or one of
+// `changed`, the ranges ts_tree_get_changed_ranges gave, are walked; every
+// other one is copied, along with the sections in it. `sections` and
+// `previous` have to be different tables, and can be swapped round for the
+// next edit. If `previous` didn't have room for all of its sections, every
+// section is walked. Returns false if there wasn't room for them all.
+static inline bool tree_sitter_orgmode_sections_update(
+    TSOrgmodeSections *sections,
+    const TSOrgmodeSections *previous,
+    const TSInputEdit *edit,
+    const TSTree *tree,
+    const TSRange *changed,
+    uint32_t changed_count,
+    const char *text
+) {
+    TSOrgmodeSectionWalk walk;
+    memset(&walk, 0, sizeof(walk));
+    walk.sections = sections;
+    walk.previous = previous->count <= previous->capacity ? previous : NULL;
+    walk.text = text;
+    walk.changed = changed;
+    walk.changed_count = changed_count;
+    walk.edit_start = edit->start_byte;
+    walk.edit_old_end = edit->old_end_byte;
+    walk.edit_new_end = edit->new_end_byte;
+    return tree_sitter_orgmode_run_section_walk(&walk, tree);
+}
+
+#endif // TREE_SITTER_ORGMODE_RUNTIME_H_
@@ -1,6 +1,10 @@
 #ifndef TREE_SITTER_ORGMODE_H_
 #define TREE_SITTER_ORGMODE_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 typedef struct TSLanguage TSLanguage;
 
 #ifdef __cplusplus
@@ -9,6 +13,247 @@ extern "C" {
 
 const TSLanguage *tree_sitter_orgmode(void);
 
+// the number of external tokens, counting the error sentinel. scanner.c
+// checks it against its own list when it can see this header.
+#define TREE_SITTER_ORGMODE_EXTERNAL_TOKEN_COUNT 34
+
+// the most distinct sets of valid tokens the scanner statistics keep apart
+#define TREE_SITTER_ORGMODE_MAX_VALID_SETS 256
+
+typedef struct {
+    uint64_t valid_tokens; // bit i is set if external token i was valid
+    uint64_t scans;
+} TSOrgmodeValidSetCount;
+
+// What the external scanner has done, counted when it's built with
+// ORGMODE_SCANNER_STATS defined. The counters are shared by every parser in
+// the process and aren't synchronised, so they're only exact when parsing
+// from one thread at a time.
+typedef struct TSOrgmodeScannerStats {
+    uint64_t scans;
+    uint64_t tokens[TREE_SITTER_ORGMODE_EXTERNAL_TOKEN_COUNT]; // emitted, by token
+    uint64_t word_fallbacks; // WORDs emitted after another token failed to scan
+    uint64_t bytes_advanced;
+    uint64_t bytes_discarded; // advanced past the end of the token, or in failed scans
+    uint64_t serializations;
+    uint64_t serialized_bytes;
+    uint64_t deserializations;
+    uint64_t deserialized_bytes;
+
+    // scans by the set of tokens that were valid, most frequent first. sets
+    // seen after the first TREE_SITTER_ORGMODE_MAX_VALID_SETS are only counted
+    // in other_valid_set_scans.
+    uint32_t valid_set_count;
+    uint64_t other_valid_set_scans;
+    TSOrgmodeValidSetCount valid_sets[TREE_SITTER_ORGMODE_MAX_VALID_SETS];
+} TSOrgmodeScannerStats;
+
+// Copies the scanner's counters into `stats` and returns true, or returns
+// false if it was built without ORGMODE_SCANNER_STATS.
+bool tree_sitter_orgmode_scanner_stats(TSOrgmodeScannerStats *stats);
+
+void tree_sitter_orgmode_scanner_stats_reset(void);
+
+// the name of an external token, e.g. "BLOCK_BEGIN_MARKER", or NULL
+const char *tree_sitter_orgmode_external_token_name(unsigned token);
+
+typedef enum {
+    TS_ORGMODE_OUTLINE_HEADING,
+    TS_ORGMODE_OUTLINE_BLOCK,
+    TS_ORGMODE_OUTLINE_DRAWER,
+    TS_ORGMODE_OUTLINE_PROPERTY_DRAWER,
+} TSOrgmodeOutlineKind;
+
+// A heading, block or drawer found by tree_sitter_orgmode_outline. Offsets
+// are in bytes and rows count from 0, as in tree-sitter.
+typedef struct {
+    uint32_t kind; // a TSOrgmodeOutlineKind
+    // a heading's number of stars, or how many blocks and drawers one is in
+    uint32_t level;
+    // a heading's first star, or the '#' or ':' a block or drawer starts at
+    uint32_t start_byte;
+    uint32_t start_row;
+    // the end of a heading's line, or just past the "#+end_NAME" or ":end:"
+    // closing a block or drawer. one that's never closed ends at the start of
+    // the heading which cuts it off, or at the end of the text.
+    uint32_t end_byte;
+    uint32_t end_row;
+    bool closed;
+} TSOrgmodeOutlineEntry;
+
+// Entries in the order they start in. An outline can be reused for any
+// number of documents, and keeps its capacity between them.
+typedef struct {
+    TSOrgmodeOutlineEntry *entries;
+    uint32_t count;
+    uint32_t capacity;
+} TSOrgmodeOutline;
+
+// Finds the headings, blocks and drawers in `length` bytes of UTF-8 org text
+// without parsing it, replacing what `outline` held. This follows the
+// external scanner's rules line by line, so it finds what parsing would in a
+// document that parses without errors, many times faster. Returns false,
+// leaving the outline empty, if the text is 4 GiB or more or the entries
+// couldn't be allocated.
+bool tree_sitter_orgmode_outline(TSOrgmodeOutline *outline, const char *text, size_t length);
+
+void tree_sitter_orgmode_outline_delete(TSOrgmodeOutline *outline);
+
+// A run of whole lines, for ts_parser_set_included_ranges. Every one starts
+// at column 0 and ends at the start of a line, or at UINT32_MAX for the end
+// of the text. tree-sitter-orgmode-runtime.h parses with them.
+typedef struct {
+    uint32_t start_byte;
+    uint32_t start_row;
+    uint32_t end_byte;
+    uint32_t end_row;
+} TSOrgmodeLineRange;
+
+// The lines to parse for the section headed by outline->entries[heading] on
+// its own: the heading line of every section it's nested in, and then the
+// section itself, up to the next heading of its level or higher. If a block
+// or drawer before it was never closed, the scanner still has it open, so
+// it's one range from the start of the text to the end of the section
+// instead. Parsed like this, the section comes out as it does in a full
+// parse. Writes up to `capacity` ranges and returns how many there are, or 0
+// if the entry isn't a heading.
+uint32_t tree_sitter_orgmode_section_ranges(
+    const TSOrgmodeOutline *outline,
+    uint32_t heading,
+    TSOrgmodeLineRange *ranges,
+    uint32_t capacity
+);
+
+// The lines of every heading in the outline, with consecutive ones merged,
+// for parsing the sections of a document without their bodies. Writes up to
+// `capacity` ranges and returns how many there are.
+uint32_t tree_sitter_orgmode_heading_ranges(
+    const TSOrgmodeOutline *outline,
+    TSOrgmodeLineRange *ranges,
+    uint32_t capacity
+);
+
+// Splits `length` bytes of text, whose outline this is, into at most
+// `max_chunks` runs of whole top level sections which parse independently,
+// as near the same size as its level 1 headings allow. Nothing is split off
+// after a block or drawer that's never closed. The first starts at the start
+// of the text and the last runs to its end. Writes up to
+// `capacity` chunks and returns how many there are.
+uint32_t tree_sitter_orgmode_split(
+    const TSOrgmodeOutline *outline,
+    size_t length,
+    uint32_t max_chunks,
+    TSOrgmodeLineRange *chunks,
+    uint32_t capacity
+);
+
+typedef enum {
+    TS_ORGMODE_TODO_NONE,
+    TS_ORGMODE_TODO_TODO,
+    TS_ORGMODE_TODO_DONE,
+} TSOrgmodeTodo;
+
+// the parent of a top level section
+#define TS_ORGMODE_NO_SECTION UINT32_MAX
+
+// The sections of a parsed document, filled by tree_sitter_orgmode_sections
+// (in tree-sitter-orgmode-runtime.h) with an array for each field rather
+// than a struct for each section, so a binding can take a whole column in
+// one call. Section i is at index i of every array, in the order the
+// sections start in, and comes after every section it's in. Offsets are in
+// bytes.
+//
+// The arrays are either the caller's own or made by
+// tree_sitter_orgmode_sections_reserve, and either way they're filled again
+// for every document after without allocating.
+typedef struct {
+    // how many sections there are, which can be more than there's room for,
+    // in which case only the first `capacity` are filled
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t *levels; // the number of stars
+    uint32_t *start_bytes;
+    uint32_t *end_bytes; // up to the next heading of the same level or higher
+    // the title, or an empty range at the start of the section if it has none
+    uint32_t *title_starts;
+    uint32_t *title_ends;
+    uint32_t *parents; // the index of the section it's in, or TS_ORGMODE_NO_SECTION
+    uint8_t *todos; // a TSOrgmodeTodo
+    uint8_t *priorities; // the letter or digit in a [#A] cookie, or 0
+    // what tree_sitter_orgmode_sections_reserve allocated, or NULL
+    void *storage;
+} TSOrgmodeSections;
+
+// Makes sure there's room for `capacity` sections, keeping the ones already
+// there. Arrays the caller set up are copied into new ones. Returns false,
+// changing nothing, if it runs out of memory.
+bool tree_sitter_orgmode_sections_reserve(TSOrgmodeSections *sections, uint32_t capacity);
+
+// frees what tree_sitter_orgmode_sections_reserve allocated
+void tree_sitter_orgmode_sections_delete(TSOrgmodeSections *sections);
+
+// the number of CPUs online, or 1 if that can't be found out
+unsigned tree_sitter_orgmode_cpu_count(void);
+
+// `worker` numbers the thread running the task, from 0 up to the number
+// asked for, so it can index things each thread keeps for itself
+typedef void (*TSOrgmodeParallelTask)(void *context, unsigned worker, uint32_t item);
+
+// Runs `task` for every item below `count` on up to `threads` threads, the
+// calling one among them, and returns once they've all been done. Items are
+// handed out one at a time in order. Returns false, having run nothing, if
+// it runs out of memory. Built for Windows, it runs everything on the
+// calling thread.
+bool tree_sitter_orgmode_run_parallel(
+    unsigned threads,
+    uint32_t count,
+    TSOrgmodeParallelTask task,
+    void *context
+);
+
+// A file mapped into memory, for tree_sitter_orgmode_mapped_input. An empty
+// file has no data.
+typedef struct {
+    const char *data;
+    size_t size;
+} TSOrgmodeMappedFile;
+
+// Maps the file at `path` into memory, read only. Returns false, with errno
+// set, if it can't, which is always on Windows.
+bool tree_sitter_orgmode_mapped_file_open(TSOrgmodeMappedFile *file, const char *path);
+
+void tree_sitter_orgmode_mapped_file_close(TSOrgmodeMappedFile *file);
+
+// A TSInput read function, taking a TSOrgmodeMappedFile as its payload and
+// giving the rest of the file from `byte_index` without copying it
+const char *tree_sitter_orgmode_mapped_file_read(void *payload, uint32_t byte_index, uint32_t *bytes_read);
+
+// A file descriptor read from a chunk at a time, for
+// tree_sitter_orgmode_stream_input, so that parsing a file of any size
+// takes just the one chunk of memory on top of the tree. A chunk never ends
+// part way through a UTF-8 character. The parser goes back over text it's
+// had before, so the file must be one that can be read at any offset, not
+// a pipe or a socket.
+typedef struct {
+    int fd;
+    uint32_t chunk_size;
+    char *buffer;
+    // a read failed, with errno `error`, and the parse was given the end of
+    // the file in its place
+    bool failed;
+    int error;
+} TSOrgmodeFileStream;
+
+// Returns false, with errno set, if it runs out of memory. The descriptor
+// still belongs to the caller.
+bool tree_sitter_orgmode_file_stream_init(TSOrgmodeFileStream *stream, int fd, uint32_t chunk_size);
+
+void tree_sitter_orgmode_file_stream_delete(TSOrgmodeFileStream *stream);
+
+// A TSInput read function, taking a TSOrgmodeFileStream as its payload. The
+// chunk it returns is good until the next read.
+const char *tree_sitter_orgmode_file_stream_read(void *payload, uint32_t byte_index, uint32_t *bytes_read);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,8 @@
 package tree_sitter_orgmode_test
 
 import (
+	"fmt"
+	"strings"
 	"testing"
 
 	tree_sitter "github.com/tree-sitter/go-tree-sitter"
@@ -13,3 +15,134 @@ func TestCanLoadGrammar(t *testing.T) {
 		t.Errorf("Error loading org mode grammar")
 	}
 }
+
+// about 4 MiB of sections, each with a keyword, a property drawer, and
+// paragraphs with links and markup
+func corpus() []byte {
+	var b strings.Builder
+	for i := 0; b.Len() < 4<<20; i++ {
+		fmt.Fprintf(&b, "* Section %d\n:PROPERTIES:\n:ID: id-%d\n:CREATED: [2024-01-%02d]\n:END:\n", i, i, i%28+1)
+		fmt.Fprintf(&b, "#+KEYWORD: value %d\n", i)
+		fmt.Fprintf(&b, "Some *bold* text with a [[https://example.com/%d][link %d]] in it.\n\n", i, i)
+		fmt.Fprintf(&b, "** Subsection %d\nA plain [[file:notes-%d.org]] link, and /italic/ text.\n\n", i, i)
+	}
+	return []byte(b.String())
+}
+
+var entityKinds = map[string]tree_sitter_orgmode.EntityKind{
+	"section":       tree_sitter_orgmode.EntitySection,
+	"keyword":       tree_sitter_orgmode.EntityKeyword,
+	"regular_link":  tree_sitter_orgmode.EntityLink,
+	"node_property": tree_sitter_orgmode.EntityProperty,
+}
+
+type walked struct {
+	kind  tree_sitter_orgmode.EntityKind
+	start uint
+	name  string
+}
+
+// walkEntities finds the same entities as Extract, node by node through
+// go-tree-sitter, and their names
+func walkEntities(tree *tree_sitter.Tree, text []byte) []walked {
+	var found []walked
+	cursor := tree.Walk()
+	defer cursor.Close()
+	for {
+		node := cursor.Node()
+		if kind, ok := entityKinds[node.Kind()]; ok {
+			var name *tree_sitter.Node
+			switch kind {
+			case tree_sitter_orgmode.EntitySection:
+				name = node.Child(0).ChildByFieldName("title")
+			case tree_sitter_orgmode.EntityKeyword:
+				name = node.NamedChild(0)
+			case tree_sitter_orgmode.EntityLink:
+				name = node.ChildByFieldName("pathreg")
+			case tree_sitter_orgmode.EntityProperty:
+				name = node.ChildByFieldName("name")
+			}
+			w := walked{kind: kind, start: node.StartByte()}
+			if name != nil {
+				w.name = name.Utf8Text(text)
+			}
+			found = append(found, w)
+		}
+		if cursor.GotoFirstChild() {
+			continue
+		}
+		for !cursor.GotoNextSibling() {
+			if !cursor.GotoParent() {
+				return found
+			}
+		}
+	}
+}
+
+func TestExtractMatchesWalk(t *testing.T) {
+	text := corpus()[:1<<16]
+	parser := tree_sitter.NewParser()
+	defer parser.Close()
+	parser.SetLanguage(tree_sitter.NewLanguage(tree_sitter_orgmode.Language()))
+	tree := parser.Parse(text, nil)
+	defer tree.Close()
+	want := walkEntities(tree, text)
+
+	extractor, err := tree_sitter_orgmode.NewExtractor()
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer extractor.Close()
+	entities, errorCount, err := extractor.Extract(text)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if errorCount != 0 {
+		t.Errorf("%d errors in the corpus", errorCount)
+	}
+	if len(entities) != len(want) {
+		t.Fatalf("extracted %d entities, but walked %d", len(entities), len(want))
+	}
+	for i, e := range entities {
+		if e.Kind != want[i].kind || uint(e.StartByte) != want[i].start {
+			t.Fatalf("entity %d is kind %d at %d, but walked kind %d at %d",
+				i, e.Kind, e.StartByte, want[i].kind, want[i].start)
+		}
+		if e.Kind == tree_sitter_orgmode.EntityLink && string(e.Name(text)) != want[i].name {
+			t.Errorf("link %d goes to %q, but walked %q", i, e.Name(text), want[i].name)
+		}
+		if e.Kind == tree_sitter_orgmode.EntitySection && e.Level == 2 && e.Parent == tree_sitter_orgmode.NoParent {
+			t.Errorf("subsection %d isn't in a section", i)
+		}
+	}
+}
+
+func BenchmarkExtract(b *testing.B) {
+	text := corpus()
+	extractor, err := tree_sitter_orgmode.NewExtractor()
+	if err != nil {
+		b.Fatal(err)
+	}
+	defer extractor.Close()
+	b.SetBytes(int64(len(text)))
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if _, _, err := extractor.Extract(text); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkParseAndWalk(b *testing.B) {
+	text := corpus()
+	parser := tree_sitter.NewParser()
+	defer parser.Close()
+	parser.SetLanguage(tree_sitter.NewLanguage(tree_sitter_orgmode.Language()))
+	b.SetBytes(int64(len(text)))
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		tree := parser.Parse(text, nil)
+		walkEntities(tree, text)
+		tree.Close()
+	}
+}
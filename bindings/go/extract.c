@@ -0,0 +1,237 @@
+// Everything an indexer wants from a document, found in one call from Go
+// rather than a cgo call for every node it walks.
+//
+// The tree-sitter runtime is compiled into go-tree-sitter, which isn't
+// vendored here, and cgo can't put another module's directory on the
+// include path. So the parts of its API this uses are declared below, as
+// they are in the api.h of the go-tree-sitter go.mod asks for, v0.24.0, and
+// they're linked in from go-tree-sitter (see extract.go). The structs passed
+// by value are checked against that header's layout; a go-tree-sitter that
+// changes them needs these changing too.
+
+#include "extract.h"
+
+#include "../../src/tree_sitter/array.h"
+
+#include <stddef.h>
+#include <string.h>
+
+typedef uint16_t TSSymbol;
+typedef uint16_t TSFieldId;
+typedef struct TSLanguage TSLanguage;
+typedef struct TSTree TSTree;
+
+typedef struct {
+    uint32_t row;
+    uint32_t column;
+} TSPoint;
+
+typedef struct {
+    uint32_t context[4];
+    const void *id;
+    const TSTree *tree;
+} TSNode;
+
+typedef struct {
+    const void *tree;
+    const void *id;
+    uint32_t context[3];
+} TSTreeCursor;
+
+// the sizes in go-tree-sitter v0.24.0's api.h, for 64 and 32 bit targets
+_Static_assert(sizeof(TSPoint) == 8, "TSPoint doesn't match go-tree-sitter v0.24.0");
+_Static_assert(sizeof(TSNode) == TS_ORGMODE_TS_NODE_SIZE, "TSNode doesn't match go-tree-sitter v0.24.0");
+_Static_assert(offsetof(TSNode, id) == 16, "TSNode doesn't match go-tree-sitter v0.24.0");
+_Static_assert(sizeof(TSTreeCursor) == (sizeof(void *) == 8 ? 32 : 20), "TSTreeCursor doesn't match go-tree-sitter v0.24.0");
+_Static_assert(offsetof(TSTreeCursor, context) == 2 * sizeof(void *), "TSTreeCursor doesn't match go-tree-sitter v0.24.0");
+
+TSParser *ts_parser_new(void);
+void ts_parser_delete(TSParser *self);
+bool ts_parser_set_language(TSParser *self, const TSLanguage *language);
+TSTree *ts_parser_parse_string(TSParser *self, const TSTree *old_tree, const char *string, uint32_t length);
+void ts_tree_delete(TSTree *self);
+TSNode ts_tree_root_node(const TSTree *self);
+TSSymbol ts_node_symbol(TSNode self);
+uint32_t ts_node_start_byte(TSNode self);
+uint32_t ts_node_end_byte(TSNode self);
+TSPoint ts_node_start_point(TSNode self);
+bool ts_node_is_null(TSNode self);
+bool ts_node_is_missing(TSNode self);
+TSNode ts_node_child(TSNode self, uint32_t child_index);
+TSNode ts_node_named_child(TSNode self, uint32_t child_index);
+TSNode ts_node_child_by_field_id(TSNode self, TSFieldId field_id);
+TSTreeCursor ts_tree_cursor_new(TSNode node);
+void ts_tree_cursor_delete(TSTreeCursor *self);
+TSNode ts_tree_cursor_current_node(const TSTreeCursor *self);
+bool ts_tree_cursor_goto_first_child(TSTreeCursor *self);
+bool ts_tree_cursor_goto_next_sibling(TSTreeCursor *self);
+bool ts_tree_cursor_goto_parent(TSTreeCursor *self);
+TSSymbol ts_language_symbol_for_name(const TSLanguage *self, const char *string, uint32_t length, bool is_named);
+TSFieldId ts_language_field_id_for_name(const TSLanguage *self, const char *name, uint32_t name_length);
+
+// the symbol tree-sitter gives error nodes
+#define ERROR_SYMBOL ((TSSymbol) -1)
+
+const TSLanguage *tree_sitter_orgmode(void);
+
+typedef struct {
+    TSSymbol section;
+    TSSymbol keyword;
+    TSSymbol regular_link;
+    TSSymbol node_property;
+    TSFieldId title;
+    TSFieldId pathreg;
+    TSFieldId description;
+    TSFieldId name;
+    TSFieldId value;
+} Symbols;
+
+typedef struct {
+    uint32_t entity;
+    uint32_t depth;
+} OpenSection;
+
+typedef struct {
+    TSOrgmodeEntity *entities;
+    uint32_t capacity;
+    uint32_t count;
+} Found;
+
+static TSSymbol symbol(const TSLanguage *language, const char *name) {
+    return ts_language_symbol_for_name(language, name, (uint32_t) strlen(name), true);
+}
+
+static TSFieldId field(const TSLanguage *language, const char *name) {
+    return ts_language_field_id_for_name(language, name, (uint32_t) strlen(name));
+}
+
+static void set_name(TSOrgmodeEntity *entity, TSNode node) {
+    if (ts_node_is_null(node)) return;
+    entity->name_start = ts_node_start_byte(node);
+    entity->name_end = ts_node_end_byte(node);
+}
+
+static void set_value(TSOrgmodeEntity *entity, TSNode node) {
+    if (ts_node_is_null(node)) return;
+    entity->value_start = ts_node_start_byte(node);
+    entity->value_end = ts_node_end_byte(node);
+}
+
+// takes `prefix` bytes off the front of the name and `suffix` off the back,
+// if it's long enough to have them
+static void trim_name(TSOrgmodeEntity *entity, uint32_t prefix, uint32_t suffix) {
+    if (entity->name_end - entity->name_start < prefix + suffix) return;
+    entity->name_start += prefix;
+    entity->name_end -= suffix;
+}
+
+static void add(Found *found, const TSOrgmodeEntity *entity) {
+    if (found->count < found->capacity) found->entities[found->count] = *entity;
+    found->count++;
+}
+
+TSParser *tree_sitter_orgmode_extract_parser(void) {
+    TSParser *parser = ts_parser_new();
+    if (!ts_parser_set_language(parser, tree_sitter_orgmode())) {
+        ts_parser_delete(parser);
+        return NULL;
+    }
+    return parser;
+}
+
+void tree_sitter_orgmode_extract_parser_delete(TSParser *parser) {
+    ts_parser_delete(parser);
+}
+
+bool tree_sitter_orgmode_extract(
+    TSParser *parser,
+    const char *text,
+    uint32_t length,
+    TSOrgmodeEntity *entities,
+    uint32_t capacity,
+    uint32_t *count,
+    uint32_t *errors
+) {
+    *count = 0;
+    *errors = 0;
+    TSTree *tree = ts_parser_parse_string(parser, NULL, text, length);
+    if (tree == NULL) return false;
+
+    const TSLanguage *language = tree_sitter_orgmode();
+    Symbols symbols = {
+        .section = symbol(language, "section"),
+        .keyword = symbol(language, "keyword"),
+        .regular_link = symbol(language, "regular_link"),
+        .node_property = symbol(language, "node_property"),
+        .title = field(language, "title"),
+        .pathreg = field(language, "pathreg"),
+        .description = field(language, "description"),
+        .name = field(language, "name"),
+        .value = field(language, "value"),
+    };
+
+    Found found = {entities, capacity, 0};
+    Array(OpenSection) open = array_new();
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+    uint32_t depth = 0;
+
+    for (;;) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        TSSymbol sym = ts_node_symbol(node);
+
+        // a section is open until the walk gets back up to its depth
+        while (open.size > 0 && array_back(&open)->depth >= depth) array_pop(&open);
+
+        if (ts_node_is_missing(node) || sym == ERROR_SYMBOL) (*errors)++;
+
+        if (sym == symbols.section || sym == symbols.keyword ||
+            sym == symbols.regular_link || sym == symbols.node_property) {
+            TSOrgmodeEntity entity = {
+                .parent = open.size > 0 ? array_back(&open)->entity : TS_ORGMODE_NO_PARENT,
+                .start_byte = ts_node_start_byte(node),
+                .end_byte = ts_node_end_byte(node),
+                .start_row = ts_node_start_point(node).row,
+            };
+
+            if (sym == symbols.section) {
+                TSNode heading = ts_node_child(node, 0);
+                TSNode stars = ts_node_child(heading, 0);
+                entity.kind = TS_ORGMODE_ENTITY_SECTION;
+                entity.level = ts_node_end_byte(stars) - ts_node_start_byte(stars);
+                set_name(&entity, ts_node_child_by_field_id(heading, symbols.title));
+                array_push(&open, ((OpenSection) {found.count, depth}));
+            } else if (sym == symbols.keyword) {
+                entity.kind = TS_ORGMODE_ENTITY_KEYWORD;
+                set_name(&entity, ts_node_named_child(node, 0));
+                trim_name(&entity, 2, 1);
+                set_value(&entity, ts_node_named_child(node, 1));
+            } else if (sym == symbols.regular_link) {
+                entity.kind = TS_ORGMODE_ENTITY_LINK;
+                set_name(&entity, ts_node_child_by_field_id(node, symbols.pathreg));
+                set_value(&entity, ts_node_child_by_field_id(node, symbols.description));
+            } else {
+                entity.kind = TS_ORGMODE_ENTITY_PROPERTY;
+                set_name(&entity, ts_node_child_by_field_id(node, symbols.name));
+                trim_name(&entity, 1, 1);
+                set_value(&entity, ts_node_child_by_field_id(node, symbols.value));
+            }
+            add(&found, &entity);
+        }
+
+        if (ts_tree_cursor_goto_first_child(&cursor)) {
+            depth++;
+            continue;
+        }
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) goto done;
+            depth--;
+        }
+    }
+
+done:
+    ts_tree_cursor_delete(&cursor);
+    array_delete(&open);
+    ts_tree_delete(tree);
+    *count = found.count;
+    return true;
+}
@@ -0,0 +1,133 @@
+package tree_sitter_orgmode
+
+// #cgo CFLAGS: -std=c11 -fPIC
+// #include "extract.h"
+import "C"
+
+import (
+	"errors"
+	"math"
+	"runtime"
+	"unsafe"
+
+	// extract.c calls into the tree-sitter runtime, which this links in
+	tree_sitter "github.com/tree-sitter/go-tree-sitter"
+)
+
+// extract.c declares the runtime's TSNode itself, so it has to be the size
+// of the one go-tree-sitter's Node wraps.
+var _ [unsafe.Sizeof(tree_sitter.Node{}) - C.TS_ORGMODE_TS_NODE_SIZE]struct{}
+var _ [C.TS_ORGMODE_TS_NODE_SIZE - unsafe.Sizeof(tree_sitter.Node{})]struct{}
+
+type EntityKind uint32
+
+const (
+	EntitySection EntityKind = iota
+	EntityKeyword
+	EntityLink
+	EntityProperty
+)
+
+// The Parent of an entity that isn't in a section.
+const NoParent = math.MaxUint32
+
+// Entity is a section, keyword, link or property found by Extract. Offsets
+// are in bytes of the text it was found in.
+type Entity struct {
+	Kind EntityKind
+	// A section's number of stars.
+	Level uint32
+	// The index of the section it's in, or NoParent.
+	Parent    uint32
+	StartByte uint32
+	EndByte   uint32
+	StartRow  uint32
+	// A section's title, a keyword's key without "#+" and ":", a link's
+	// target or a property's name without its colons.
+	NameStart uint32
+	NameEnd   uint32
+	// A keyword's or a property's value, or a link's description.
+	ValueStart uint32
+	ValueEnd   uint32
+}
+
+// Name returns the entity's name in the text it was found in.
+func (e *Entity) Name(text []byte) []byte {
+	return text[e.NameStart:e.NameEnd]
+}
+
+// Value returns the entity's value in the text it was found in.
+func (e *Entity) Value(text []byte) []byte {
+	return text[e.ValueStart:e.ValueEnd]
+}
+
+// Entity has to be laid out just as TSOrgmodeEntity is.
+var _ [unsafe.Sizeof(Entity{}) - unsafe.Sizeof(C.TSOrgmodeEntity{})]struct{}
+var _ [unsafe.Sizeof(C.TSOrgmodeEntity{}) - unsafe.Sizeof(Entity{})]struct{}
+
+// An Extractor parses documents and finds their sections, keywords, links
+// and properties in a single cgo call for each document. It isn't safe for
+// use by more than one goroutine at a time.
+type Extractor struct {
+	parser   *C.TSParser
+	entities []Entity
+}
+
+func NewExtractor() (*Extractor, error) {
+	parser := C.tree_sitter_orgmode_extract_parser()
+	if parser == nil {
+		return nil, errors.New("the orgmode language is incompatible with the tree-sitter runtime")
+	}
+	e := &Extractor{parser: parser}
+	runtime.SetFinalizer(e, (*Extractor).Close)
+	return e, nil
+}
+
+// Close frees the extractor's parser.
+func (e *Extractor) Close() {
+	if e.parser != nil {
+		C.tree_sitter_orgmode_extract_parser_delete(e.parser)
+		e.parser = nil
+	}
+	runtime.SetFinalizer(e, nil)
+}
+
+// Extract parses text and returns the entities in it, in the order they
+// start in, and the number of error and missing nodes in the tree. The
+// entities are only good until the next call, which reuses their memory.
+func (e *Extractor) Extract(text []byte) ([]Entity, int, error) {
+	if e.parser == nil {
+		return nil, 0, errors.New("the extractor is closed")
+	}
+	if uint64(len(text)) > math.MaxUint32 {
+		return nil, 0, errors.New("the text is 4 GiB or more")
+	}
+	if cap(e.entities) == 0 {
+		e.entities = make([]Entity, 0, len(text)/64+16)
+	}
+
+	var data *C.char
+	if len(text) > 0 {
+		data = (*C.char)(unsafe.Pointer(&text[0]))
+	}
+
+	// if there are more entities than room for them, it's parsed again with
+	// enough, which is kept for the documents after
+	for {
+		var count, errorCount C.uint32_t
+		entities := e.entities[:cap(e.entities)]
+		ok := C.tree_sitter_orgmode_extract(
+			e.parser, data, C.uint32_t(len(text)),
+			(*C.TSOrgmodeEntity)(unsafe.Pointer(&entities[0])), C.uint32_t(len(entities)),
+			&count, &errorCount)
+		runtime.KeepAlive(text)
+		if !ok {
+			return nil, 0, errors.New("the parse failed")
+		}
+		if int(count) <= len(entities) {
+			e.entities = entities[:count]
+			return e.entities, int(errorCount), nil
+		}
+		e.entities = make([]Entity, 0, int(count))
+	}
+}
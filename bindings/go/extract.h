@@ -0,0 +1,60 @@
+#ifndef TREE_SITTER_ORGMODE_GO_EXTRACT_H_
+#define TREE_SITTER_ORGMODE_GO_EXTRACT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct TSParser TSParser;
+
+// the size of the runtime's TSNode, which extract.c declares for itself, so
+// that extract.go can check it against the one go-tree-sitter wraps
+#define TS_ORGMODE_TS_NODE_SIZE (4 * sizeof(uint32_t) + 2 * sizeof(void *))
+
+typedef enum {
+    TS_ORGMODE_ENTITY_SECTION,
+    TS_ORGMODE_ENTITY_KEYWORD,
+    TS_ORGMODE_ENTITY_LINK,
+    TS_ORGMODE_ENTITY_PROPERTY,
+} TSOrgmodeEntityKind;
+
+// what an entity is in if it isn't in a section
+#define TS_ORGMODE_NO_PARENT UINT32_MAX
+
+// Something tree_sitter_orgmode_extract found, laid out the same as Entity
+// in extract.go. Offsets are in bytes of the text.
+typedef struct {
+    uint32_t kind; // a TSOrgmodeEntityKind
+    uint32_t level; // a section's number of stars
+    uint32_t parent; // the index of the section it's in
+    uint32_t start_byte;
+    uint32_t end_byte;
+    uint32_t start_row;
+    // a section's title, a keyword's key without "#+" and ":", a link's
+    // target or a property's name without its colons
+    uint32_t name_start;
+    uint32_t name_end;
+    // a keyword's or a property's value, or a link's description
+    uint32_t value_start;
+    uint32_t value_end;
+} TSOrgmodeEntity;
+
+// a parser for the orgmode language, or NULL if the runtime is too old for it
+TSParser *tree_sitter_orgmode_extract_parser(void);
+
+void tree_sitter_orgmode_extract_parser_delete(TSParser *parser);
+
+// Parses `length` bytes of text and writes up to `capacity` of the sections,
+// keywords, links and properties in it, in the order they start in. Sets
+// `count` to how many there are in all, and `errors` to the number of error
+// and missing nodes. Returns false if the parse failed.
+bool tree_sitter_orgmode_extract(
+    TSParser *parser,
+    const char *text,
+    uint32_t length,
+    TSOrgmodeEntity *entities,
+    uint32_t capacity,
+    uint32_t *count,
+    uint32_t *errors
+);
+
+#endif // TREE_SITTER_ORGMODE_GO_EXTRACT_H_
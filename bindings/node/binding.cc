@@ -1,18 +1,464 @@
 #include <napi.h>
 
-typedef struct TSLanguage TSLanguage;
+#include <tree_sitter/tree-sitter-orgmode-runtime.h>
 
-extern "C" TSLanguage *tree_sitter_orgmode();
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
 
 // "tree-sitter", "language" hashed with BLAKE2
 const napi_type_tag LANGUAGE_TYPE_TAG = {
     0x8AF2E5212AD58ABF, 0xD5006CAD83ABBA16
 };
 
+// parseFile and parseBuffer parse on libuv's thread pool, with the copy of
+// the runtime binding.gyp compiles in from vendor/. The text goes to the
+// parser through a TSInput over a mapped file or a Buffer's own memory, so
+// it's never made into a JS string. Their trees belong to that runtime, not
+// to the tree-sitter package's, so they're wrapped by the Tree and
+// SyntaxNode here rather than by its classes.
+
+namespace {
+
+struct Constructors {
+    Napi::FunctionReference tree;
+    Napi::FunctionReference node;
+};
+
+class Tree : public Napi::ObjectWrap<Tree> {
+  public:
+    static Napi::Function Init(Napi::Env env) {
+        return DefineClass(env, "Tree", {
+            InstanceAccessor<&Tree::RootNode>("rootNode"),
+            InstanceAccessor<&Tree::Source>("source"),
+        });
+    }
+
+    // takes `tree`, parsed from `source`, a Uint8Array or undefined
+    static Napi::Object New(Napi::Env env, TSTree *tree, Napi::Value source) {
+        Constructors *constructors = env.GetInstanceData<Constructors>();
+        return constructors->tree.New({Napi::External<TSTree>::New(env, tree), source});
+    }
+
+    Tree(const Napi::CallbackInfo &info) : Napi::ObjectWrap<Tree>(info) {
+        if (info.Length() < 1 || !info[0].IsExternal()) {
+            throw Napi::TypeError::New(info.Env(), "trees come from parseFile and parseBuffer");
+        }
+        tree = info[0].As<Napi::External<TSTree>>().Data();
+        if (info[1].IsTypedArray()) source = Napi::Persistent(info[1].As<Napi::Object>());
+    }
+
+    ~Tree() override {
+        ts_tree_delete(tree);
+    }
+
+    // the bytes of the text between `start` and `end`, as a string, if the
+    // tree was parsed from a buffer
+    Napi::Value Text(Napi::Env env, uint32_t start, uint32_t end) {
+        if (source.IsEmpty()) return env.Undefined();
+        Napi::Uint8Array bytes = source.Value().As<Napi::Uint8Array>();
+        if (end > bytes.ByteLength() || start > end) return env.Undefined();
+        return Napi::String::New(env, reinterpret_cast<const char *>(bytes.Data()) + start, end - start);
+    }
+
+    TSTree *tree;
+
+  private:
+    Napi::Value RootNode(const Napi::CallbackInfo &info);
+
+    Napi::Value Source(const Napi::CallbackInfo &info) {
+        return source.IsEmpty() ? info.Env().Null() : source.Value();
+    }
+
+    Napi::ObjectReference source;
+};
+
+// A node of a Tree, which it keeps alive. Offsets and columns count bytes
+// of UTF-8.
+class SyntaxNode : public Napi::ObjectWrap<SyntaxNode> {
+  public:
+    static Napi::Function Init(Napi::Env env) {
+        return DefineClass(env, "SyntaxNode", {
+            InstanceAccessor<&SyntaxNode::TreeObject>("tree"),
+            InstanceAccessor<&SyntaxNode::Type>("type"),
+            InstanceAccessor<&SyntaxNode::TypeId>("typeId"),
+            InstanceAccessor<&SyntaxNode::IsNamed>("isNamed"),
+            InstanceAccessor<&SyntaxNode::IsMissing>("isMissing"),
+            InstanceAccessor<&SyntaxNode::IsExtra>("isExtra"),
+            InstanceAccessor<&SyntaxNode::HasError>("hasError"),
+            InstanceAccessor<&SyntaxNode::StartIndex>("startIndex"),
+            InstanceAccessor<&SyntaxNode::EndIndex>("endIndex"),
+            InstanceAccessor<&SyntaxNode::StartPosition>("startPosition"),
+            InstanceAccessor<&SyntaxNode::EndPosition>("endPosition"),
+            InstanceAccessor<&SyntaxNode::Text>("text"),
+            InstanceAccessor<&SyntaxNode::Parent>("parent"),
+            InstanceAccessor<&SyntaxNode::ChildCount>("childCount"),
+            InstanceAccessor<&SyntaxNode::NamedChildCount>("namedChildCount"),
+            InstanceAccessor<&SyntaxNode::Children>("children"),
+            InstanceAccessor<&SyntaxNode::NamedChildren>("namedChildren"),
+            InstanceAccessor<&SyntaxNode::FirstChild>("firstChild"),
+            InstanceAccessor<&SyntaxNode::NextSibling>("nextSibling"),
+            InstanceAccessor<&SyntaxNode::PreviousSibling>("previousSibling"),
+            InstanceMethod<&SyntaxNode::Child>("child"),
+            InstanceMethod<&SyntaxNode::NamedChild>("namedChild"),
+            InstanceMethod<&SyntaxNode::ChildForFieldName>("childForFieldName"),
+            InstanceMethod<&SyntaxNode::DescendantsOfType>("descendantsOfType"),
+            InstanceMethod<&SyntaxNode::ToString>("toString"),
+        });
+    }
+
+    // null for a null node
+    static Napi::Value New(Napi::Env env, TSNode node, Napi::Object tree) {
+        if (ts_node_is_null(node)) return env.Null();
+        Constructors *constructors = env.GetInstanceData<Constructors>();
+        return constructors->node.New({Napi::External<TSNode>::New(env, &node), tree});
+    }
+
+    SyntaxNode(const Napi::CallbackInfo &info) : Napi::ObjectWrap<SyntaxNode>(info) {
+        if (info.Length() < 2 || !info[0].IsExternal() || !info[1].IsObject()) {
+            throw Napi::TypeError::New(info.Env(), "nodes come from a Tree's rootNode");
+        }
+        node = *info[0].As<Napi::External<TSNode>>().Data();
+        tree = Napi::Persistent(info[1].As<Napi::Object>());
+    }
+
+  private:
+    Napi::Value Wrap(Napi::Env env, TSNode other) {
+        return New(env, other, tree.Value());
+    }
+
+    static Napi::Value Point(Napi::Env env, TSPoint point) {
+        Napi::Object result = Napi::Object::New(env);
+        result["row"] = Napi::Number::New(env, point.row);
+        result["column"] = Napi::Number::New(env, point.column);
+        return result;
+    }
+
+    Napi::Value TreeObject(const Napi::CallbackInfo &) {
+        return tree.Value();
+    }
+
+    Napi::Value Type(const Napi::CallbackInfo &info) {
+        return Napi::String::New(info.Env(), ts_node_type(node));
+    }
+
+    Napi::Value TypeId(const Napi::CallbackInfo &info) {
+        return Napi::Number::New(info.Env(), ts_node_symbol(node));
+    }
+
+    Napi::Value IsNamed(const Napi::CallbackInfo &info) {
+        return Napi::Boolean::New(info.Env(), ts_node_is_named(node));
+    }
+
+    Napi::Value IsMissing(const Napi::CallbackInfo &info) {
+        return Napi::Boolean::New(info.Env(), ts_node_is_missing(node));
+    }
+
+    Napi::Value IsExtra(const Napi::CallbackInfo &info) {
+        return Napi::Boolean::New(info.Env(), ts_node_is_extra(node));
+    }
+
+    Napi::Value HasError(const Napi::CallbackInfo &info) {
+        return Napi::Boolean::New(info.Env(), ts_node_has_error(node));
+    }
+
+    Napi::Value StartIndex(const Napi::CallbackInfo &info) {
+        return Napi::Number::New(info.Env(), ts_node_start_byte(node));
+    }
+
+    Napi::Value EndIndex(const Napi::CallbackInfo &info) {
+        return Napi::Number::New(info.Env(), ts_node_end_byte(node));
+    }
+
+    Napi::Value StartPosition(const Napi::CallbackInfo &info) {
+        return Point(info.Env(), ts_node_start_point(node));
+    }
+
+    Napi::Value EndPosition(const Napi::CallbackInfo &info) {
+        return Point(info.Env(), ts_node_end_point(node));
+    }
+
+    Napi::Value Text(const Napi::CallbackInfo &info) {
+        Tree *owner = Tree::Unwrap(tree.Value());
+        return owner->Text(info.Env(), ts_node_start_byte(node), ts_node_end_byte(node));
+    }
+
+    Napi::Value Parent(const Napi::CallbackInfo &info) {
+        return Wrap(info.Env(), ts_node_parent(node));
+    }
+
+    Napi::Value ChildCount(const Napi::CallbackInfo &info) {
+        return Napi::Number::New(info.Env(), ts_node_child_count(node));
+    }
+
+    Napi::Value NamedChildCount(const Napi::CallbackInfo &info) {
+        return Napi::Number::New(info.Env(), ts_node_named_child_count(node));
+    }
+
+    // the children, or only the named ones, walked with a cursor rather than
+    // looked up one at a time
+    Napi::Value ChildArray(Napi::Env env, bool named) {
+        Napi::Array result = Napi::Array::New(env);
+        TSTreeCursor cursor = ts_tree_cursor_new(node);
+        if (ts_tree_cursor_goto_first_child(&cursor)) {
+            uint32_t i = 0;
+            do {
+                TSNode child = ts_tree_cursor_current_node(&cursor);
+                if (!named || ts_node_is_named(child)) result[i++] = Wrap(env, child);
+            } while (ts_tree_cursor_goto_next_sibling(&cursor));
+        }
+        ts_tree_cursor_delete(&cursor);
+        return result;
+    }
+
+    Napi::Value Children(const Napi::CallbackInfo &info) {
+        return ChildArray(info.Env(), false);
+    }
+
+    Napi::Value NamedChildren(const Napi::CallbackInfo &info) {
+        return ChildArray(info.Env(), true);
+    }
+
+    Napi::Value FirstChild(const Napi::CallbackInfo &info) {
+        return Wrap(info.Env(), ts_node_child(node, 0));
+    }
+
+    Napi::Value NextSibling(const Napi::CallbackInfo &info) {
+        return Wrap(info.Env(), ts_node_next_sibling(node));
+    }
+
+    Napi::Value PreviousSibling(const Napi::CallbackInfo &info) {
+        return Wrap(info.Env(), ts_node_prev_sibling(node));
+    }
+
+    static uint32_t Index(const Napi::CallbackInfo &info) {
+        if (info.Length() < 1 || !info[0].IsNumber()) {
+            throw Napi::TypeError::New(info.Env(), "expected the index of a child");
+        }
+        return info[0].As<Napi::Number>().Uint32Value();
+    }
+
+    Napi::Value Child(const Napi::CallbackInfo &info) {
+        return Wrap(info.Env(), ts_node_child(node, Index(info)));
+    }
+
+    Napi::Value NamedChild(const Napi::CallbackInfo &info) {
+        return Wrap(info.Env(), ts_node_named_child(node, Index(info)));
+    }
+
+    Napi::Value ChildForFieldName(const Napi::CallbackInfo &info) {
+        if (info.Length() < 1 || !info[0].IsString()) {
+            throw Napi::TypeError::New(info.Env(), "expected the name of a field");
+        }
+        std::string name = info[0].As<Napi::String>().Utf8Value();
+        return Wrap(info.Env(), ts_node_child_by_field_name(node, name.data(), (uint32_t) name.size()));
+    }
+
+    // the descendants of one of `types`, in order, found by a walk over the
+    // subtree rather than a node object for each descendant
+    Napi::Value DescendantsOfType(const Napi::CallbackInfo &info) {
+        Napi::Env env = info.Env();
+        Napi::Array types;
+        if (info.Length() > 0 && info[0].IsString()) {
+            types = Napi::Array::New(env, 1);
+            types[0u] = info[0];
+        } else if (info.Length() > 0 && info[0].IsArray()) {
+            types = info[0].As<Napi::Array>();
+        } else {
+            throw Napi::TypeError::New(env, "expected a node type or an array of them");
+        }
+
+        const TSLanguage *language = ts_tree_language(node.tree);
+        std::vector<TSSymbol> symbols;
+        for (uint32_t i = 0; i < types.Length(); i++) {
+            std::string type = types.Get(i).ToString().Utf8Value();
+            for (bool named : {true, false}) {
+                TSSymbol symbol = ts_language_symbol_for_name(language, type.data(), (uint32_t) type.size(), named);
+                if (symbol != 0) symbols.push_back(symbol);
+            }
+        }
+
+        Napi::Array result = Napi::Array::New(env);
+        uint32_t count = 0, depth = 0;
+        TSTreeCursor cursor = ts_tree_cursor_new(node);
+        for (;;) {
+            if (ts_tree_cursor_goto_first_child(&cursor)) {
+                depth++;
+            } else {
+                while (depth > 0 && !ts_tree_cursor_goto_next_sibling(&cursor)) {
+                    ts_tree_cursor_goto_parent(&cursor);
+                    depth--;
+                }
+                if (depth == 0) break;
+            }
+            TSNode current = ts_tree_cursor_current_node(&cursor);
+            if (std::find(symbols.begin(), symbols.end(), ts_node_symbol(current)) != symbols.end()) {
+                result[count++] = Wrap(env, current);
+            }
+        }
+        ts_tree_cursor_delete(&cursor);
+        return result;
+    }
+
+    Napi::Value ToString(const Napi::CallbackInfo &info) {
+        char *string = ts_node_string(node);
+        Napi::String result = Napi::String::New(info.Env(), string);
+        std::free(string);
+        return result;
+    }
+
+    TSNode node;
+    Napi::ObjectReference tree;
+};
+
+Napi::Value Tree::RootNode(const Napi::CallbackInfo &info) {
+    return SyntaxNode::New(info.Env(), ts_tree_root_node(tree), Value());
+}
+
+class ParseWorker : public Napi::AsyncWorker {
+  public:
+    // parses the bytes of `buffer`, which is kept from being collected until
+    // the tree is, but mustn't be written to while it's parsed
+    ParseWorker(Napi::Env env, Napi::Uint8Array buffer)
+        : Napi::AsyncWorker(env, "tree-sitter-orgmode:parseBuffer"),
+          deferred(Napi::Promise::Deferred::New(env)),
+          source(Napi::Persistent(buffer.As<Napi::Object>())) {
+        text.data = reinterpret_cast<const char *>(buffer.Data());
+        text.size = buffer.ByteLength();
+    }
+
+    ParseWorker(Napi::Env env, std::string path)
+        : Napi::AsyncWorker(env, "tree-sitter-orgmode:parseFile"),
+          deferred(Napi::Promise::Deferred::New(env)),
+          from_file(true),
+          path(std::move(path)) {
+        text.data = nullptr;
+        text.size = 0;
+    }
+
+    ~ParseWorker() override {
+        if (tree != nullptr) ts_tree_delete(tree);
+    }
+
+    Napi::Promise Promise() {
+        return deferred.Promise();
+    }
+
+  protected:
+    void Execute() override {
+        if (!from_file) {
+            Parse();
+            return;
+        }
+
+        if (tree_sitter_orgmode_mapped_file_open(&text, path.c_str())) {
+            Parse();
+            tree_sitter_orgmode_mapped_file_close(&text);
+            return;
+        }
+        if (errno != ENOSYS) {
+            SetError(path + ": " + std::strerror(errno));
+            return;
+        }
+
+        // there's no mapping files here, so it's read into memory instead
+        std::ifstream stream(path, std::ios::binary);
+        std::ostringstream contents;
+        if (!(stream && contents << stream.rdbuf())) {
+            SetError(path + ": can't be read");
+            return;
+        }
+        std::string read = contents.str();
+        text.data = read.data();
+        text.size = read.size();
+        Parse();
+    }
+
+    void OnOK() override {
+        Napi::Env env = Env();
+        TSTree *parsed = tree;
+        tree = nullptr;
+        deferred.Resolve(Tree::New(env, parsed, source.IsEmpty() ? env.Undefined() : source.Value()));
+    }
+
+    void OnError(const Napi::Error &error) override {
+        deferred.Reject(error.Value());
+    }
+
+  private:
+    void Parse() {
+        if (text.size > UINT32_MAX) {
+            SetError((from_file ? path : std::string("the buffer")) + " is 4 GiB or more");
+            return;
+        }
+
+        TSParser *parser = ts_parser_new();
+        if (!ts_parser_set_language(parser, tree_sitter_orgmode())) {
+            ts_parser_delete(parser);
+            SetError("the orgmode language is incompatible with this tree-sitter runtime");
+            return;
+        }
+        tree = ts_parser_parse(parser, nullptr, tree_sitter_orgmode_mapped_input(&text));
+        ts_parser_delete(parser);
+        if (tree == nullptr) SetError("the parse failed");
+    }
+
+    Napi::Promise::Deferred deferred;
+    Napi::ObjectReference source;
+    TSOrgmodeMappedFile text;
+    bool from_file = false;
+    std::string path;
+    TSTree *tree = nullptr;
+};
+
+Napi::Value ParseFile(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString()) {
+        throw Napi::TypeError::New(env, "parseFile takes the path of a file");
+    }
+    ParseWorker *worker = new ParseWorker(env, info[0].As<Napi::String>().Utf8Value());
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+Napi::Value ParseBuffer(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsTypedArray() ||
+        info[0].As<Napi::TypedArray>().TypedArrayType() != napi_uint8_array) {
+        throw Napi::TypeError::New(env, "parseBuffer takes a Buffer or Uint8Array of UTF-8 text");
+    }
+    ParseWorker *worker = new ParseWorker(env, info[0].As<Napi::Uint8Array>());
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+} // namespace
+
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
-    auto language = Napi::External<TSLanguage>::New(env, tree_sitter_orgmode());
+    auto language = Napi::External<TSLanguage>::New(env, const_cast<TSLanguage *>(tree_sitter_orgmode()));
     language.TypeTag(&LANGUAGE_TYPE_TAG);
     exports["language"] = language;
+
+    Constructors *constructors = new Constructors();
+    Napi::Function tree = Tree::Init(env);
+    Napi::Function node = SyntaxNode::Init(env);
+    constructors->tree = Napi::Persistent(tree);
+    constructors->node = Napi::Persistent(node);
+    env.SetInstanceData(constructors);
+
+    exports["Tree"] = tree;
+    exports["SyntaxNode"] = node;
+    exports["parseFile"] = Napi::Function::New(env, ParseFile, "parseFile");
+    exports["parseBuffer"] = Napi::Function::New(env, ParseBuffer, "parseBuffer");
     return exports;
 }
 
@@ -1,4 +1,7 @@
 const assert = require("node:assert");
+const fs = require("node:fs");
+const os = require("node:os");
+const path = require("node:path");
 const { test } = require("node:test");
 
 const Parser = require("tree-sitter");
@@ -7,3 +10,43 @@ test("can load grammar", () => {
   const parser = new Parser();
   assert.doesNotThrow(() => parser.setLanguage(require(".")));
 });
+
+const orgmode = require(".");
+
+// node types in preorder, which don't depend on how offsets are counted
+const types = (node) => [node.type, ...node.children.flatMap(types)];
+
+const parseHere = (text) => {
+  const parser = new Parser();
+  parser.setLanguage(orgmode);
+  return parser.parse(text).rootNode;
+};
+
+test("parses a buffer off the main thread", async () => {
+  const text = "* Résumé\nSome text.\n** Sub\n";
+  const tree = await orgmode.parseBuffer(Buffer.from(text));
+  assert.deepStrictEqual(types(tree.rootNode), types(parseHere(text)));
+  assert.strictEqual(tree.rootNode.toString(), parseHere(text).toString());
+  assert.strictEqual(tree.rootNode.endIndex, Buffer.byteLength(text));
+  assert.strictEqual(tree.rootNode.firstChild.text.split("\n")[0], "* Résumé");
+  assert.strictEqual(tree.rootNode.descendantsOfType("heading").length, 2);
+  await assert.rejects(async () => orgmode.parseBuffer(text), TypeError);
+});
+
+test("parses a file off the main thread", async () => {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), "orgmode-"));
+  const file = path.join(dir, "test.org");
+  const text = "* Heading\n#+begin_src c\nint x;\n#+end_src\n";
+  fs.writeFileSync(file, text);
+  try {
+    const trees = await Promise.all([1, 2, 3].map(() => orgmode.parseFile(file)));
+    for (const tree of trees) {
+      assert.strictEqual(tree.rootNode.toString(), parseHere(text).toString());
+      assert.strictEqual(tree.rootNode.hasError, false);
+      assert.strictEqual(tree.source, null);
+    }
+    await assert.rejects(orgmode.parseFile(path.join(dir, "missing.org")));
+  } finally {
+    fs.rmSync(dir, { recursive: true });
+  }
+});
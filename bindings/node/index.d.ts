@@ -18,9 +18,56 @@ type NodeInfo =
       children: ChildNode[];
     });
 
+type Point = {
+  row: number;
+  column: number;
+};
+
+// A node of a tree from parseFile or parseBuffer. Offsets and columns count
+// bytes of UTF-8.
+interface SyntaxNode {
+  readonly tree: Tree;
+  readonly type: string;
+  readonly typeId: number;
+  readonly isNamed: boolean;
+  readonly isMissing: boolean;
+  readonly isExtra: boolean;
+  readonly hasError: boolean;
+  readonly startIndex: number;
+  readonly endIndex: number;
+  readonly startPosition: Point;
+  readonly endPosition: Point;
+  // only there for trees parsed from a buffer
+  readonly text: string | undefined;
+  readonly parent: SyntaxNode | null;
+  readonly childCount: number;
+  readonly namedChildCount: number;
+  readonly children: SyntaxNode[];
+  readonly namedChildren: SyntaxNode[];
+  readonly firstChild: SyntaxNode | null;
+  readonly nextSibling: SyntaxNode | null;
+  readonly previousSibling: SyntaxNode | null;
+  child(index: number): SyntaxNode | null;
+  namedChild(index: number): SyntaxNode | null;
+  childForFieldName(name: string): SyntaxNode | null;
+  descendantsOfType(types: string | string[]): SyntaxNode[];
+  toString(): string;
+}
+
+// These trees come from the binding's own copy of the runtime, so they
+// can't be given to the tree-sitter package's Parser or Query.
+interface Tree {
+  readonly rootNode: SyntaxNode;
+  readonly source: Uint8Array | null;
+}
+
 type Language = {
   language: unknown;
   nodeTypeInfo: NodeInfo[];
+  // These parse on libuv's thread pool, from a mapped file or the buffer's
+  // own bytes. A buffer mustn't be changed until its parse has resolved.
+  parseFile: (path: string) => Promise<Tree>;
+  parseBuffer: (buffer: Uint8Array) => Promise<Tree>;
 };
 
 declare const language: Language;
@@ -1,6 +1,9 @@
+from mmap import ACCESS_READ, mmap
+from os import path
+from tempfile import TemporaryDirectory
 from unittest import TestCase
 
-from tree_sitter import Language, Parser
+from tree_sitter import Language, Parser, Query
 import tree_sitter_orgmode
 
 
@@ -10,3 +13,40 @@ class TestLanguage(TestCase):
             Parser(Language(tree_sitter_orgmode.language()))
         except Exception:
             self.fail("Error loading org mode grammar")
+
+    def test_queries_compile(self):
+        language = Language(tree_sitter_orgmode.language())
+        for name in ["HIGHLIGHTS_QUERY", "INJECTIONS_QUERY", "FOLDS_QUERY"]:
+            with self.subTest(name):
+                Query(language, getattr(tree_sitter_orgmode, name))
+
+
+class TestParseMany(TestCase):
+    TEXT = b"#+TITLE: Notes\n* Caf\xc3\xa9\n** TODO Sub\n* Last\n"
+
+    def test_headings_and_keywords(self):
+        [(headings, keywords, errors)] = tree_sitter_orgmode.parse_many([self.TEXT])
+        self.assertEqual([(level, row) for level, _, row in headings], [(1, 1), (2, 2), (1, 3)])
+        self.assertEqual(headings[0][1].strip(), "Caf\u00e9")
+        self.assertEqual([(key, value.strip(), row) for key, value, row in keywords], [("TITLE", "Notes", 0)])
+        self.assertEqual(errors, 0)
+
+    def test_files_match_buffers(self):
+        with TemporaryDirectory() as directory:
+            file = path.join(directory, "notes.org")
+            with open(file, "wb") as f:
+                f.write(self.TEXT)
+            results = tree_sitter_orgmode.parse_many([file, self.TEXT] * 8, threads=4)
+            self.assertTrue(all(result == results[0] for result in results))
+            with self.assertRaises(OSError):
+                tree_sitter_orgmode.parse_many([path.join(directory, "missing.org")])
+
+    def test_buffers(self):
+        with TemporaryDirectory() as directory:
+            file = path.join(directory, "notes.org")
+            with open(file, "wb") as f:
+                f.write(self.TEXT)
+            with open(file, "rb") as f, mmap(f.fileno(), 0, access=ACCESS_READ) as mapped:
+                sources = [self.TEXT, bytearray(self.TEXT), memoryview(self.TEXT), mapped]
+                results = tree_sitter_orgmode.parse_many(sources)
+            self.assertTrue(all(result == results[0] for result in results))
@@ -1,10 +1,28 @@
-from typing import Final
+from mmap import mmap
+from os import PathLike
+from typing import Final, Sequence
+
+HIGHLIGHTS_QUERY: Final[str]
+INJECTIONS_QUERY: Final[str]
+FOLDS_QUERY: Final[str]
 
 # NOTE: uncomment these to include any queries that this grammar contains:
 
-# HIGHLIGHTS_QUERY: Final[str]
-# INJECTIONS_QUERY: Final[str]
 # LOCALS_QUERY: Final[str]
 # TAGS_QUERY: Final[str]
 
 def language() -> object: ...
+
+# (level, title, row), with rows counted from 0
+Heading = tuple[int, str, int]
+# (key, value, row), with the key as in "#+KEY: value"
+Keyword = tuple[str, str, int]
+
+# Parses every source on up to `threads` threads (by default one for each
+# CPU), without holding the GIL. A buffer (bytes, bytearray, a memoryview,
+# an mmap) is the text of a document, and a str or path is a file to read.
+# Gives (headings, keywords, errors) for each source, in order, where errors
+# counts error and missing nodes.
+def parse_many(
+    sources: Sequence[bytes | bytearray | memoryview | mmap | str | PathLike[str]], threads: int = 0
+) -> list[tuple[tuple[Heading, ...], tuple[Keyword, ...], int]]: ...
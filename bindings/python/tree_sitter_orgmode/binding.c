@@ -2,10 +2,372 @@
 
 typedef struct TSLanguage TSLanguage;
 
-TSLanguage *tree_sitter_orgmode(void);
+const TSLanguage *tree_sitter_orgmode(void);
 
 static PyObject* _binding_language(PyObject *Py_UNUSED(self), PyObject *Py_UNUSED(args)) {
-    return PyCapsule_New(tree_sitter_orgmode(), "tree_sitter.Language", NULL);
+    return PyCapsule_New((void *) tree_sitter_orgmode(), "tree_sitter.Language", NULL);
+}
+
+// parse_many's runtime is the copy setup.py compiles in, from vendor/
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-orgmode.h>
+
+#include "tree_sitter/array.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+// the symbol tree-sitter gives error nodes
+#define ERROR_SYMBOL ((TSSymbol) -1)
+
+// offsets into a Document's strings
+typedef struct {
+    uint32_t start;
+    uint32_t length;
+} Slice;
+
+typedef struct {
+    uint32_t level;
+    uint32_t row;
+    Slice title;
+} Heading;
+
+typedef struct {
+    uint32_t row;
+    Slice key;
+    Slice value;
+} Keyword;
+
+// One of the sources, and what parse_many found in it. Everything here is
+// made without the GIL; the strings are copied out of the text so a mapped
+// file can be closed before they're turned into Python strings.
+typedef struct {
+    const char *path; // or NULL, with the text in `text`
+    const char *text; // a buffer's, held until the parses are done
+    size_t length;
+
+    Array(Heading) headings;
+    Array(Keyword) keywords;
+    Array(char) strings;
+    uint32_t errors;
+    int error; // errno, if the file couldn't be read
+    bool failed; // the parse failed
+} Document;
+
+typedef struct {
+    TSSymbol document;
+    TSSymbol section;
+    TSSymbol body;
+    TSSymbol element;
+    TSSymbol heading;
+    TSSymbol keyword;
+    TSFieldId title;
+} Symbols;
+
+typedef struct {
+    Document *documents;
+    TSParser **parsers; // one for each thread, made by the thread
+    const Symbols *symbols;
+} Batch;
+
+static Slice copy_slice(Document *doc, const char *text, uint32_t start, uint32_t end) {
+    Slice slice = {doc->strings.size, end - start};
+    array_extend(&doc->strings, end - start, text + start);
+    return slice;
+}
+
+static void add_heading(Document *doc, const Symbols *symbols, TSNode node, const char *text) {
+    TSNode stars = ts_node_child(node, 0);
+    TSNode title = ts_node_child_by_field_id(node, symbols->title);
+    Heading heading = {
+        .level = ts_node_end_byte(stars) - ts_node_start_byte(stars),
+        .row = ts_node_start_point(node).row,
+    };
+    if (!ts_node_is_null(title)) {
+        heading.title = copy_slice(doc, text, ts_node_start_byte(title), ts_node_end_byte(title));
+    }
+    array_push(&doc->headings, heading);
+}
+
+// the key without its "#+" and ":", so "#+TITLE:" is "TITLE"
+static void add_keyword(Document *doc, TSNode node, const char *text) {
+    TSNode key = ts_node_named_child(node, 0);
+    TSNode value = ts_node_named_child(node, 1);
+    uint32_t key_start = ts_node_start_byte(key), key_end = ts_node_end_byte(key);
+    if (key_end - key_start >= 3) {
+        key_start += 2;
+        key_end -= 1;
+    }
+
+    Keyword keyword = {.row = ts_node_start_point(node).row};
+    keyword.key = copy_slice(doc, text, key_start, key_end);
+    if (!ts_node_is_null(value)) {
+        keyword.value = copy_slice(doc, text, ts_node_start_byte(value), ts_node_end_byte(value));
+    }
+    array_push(&doc->keywords, keyword);
+}
+
+// Headings and keywords are only ever in the document, sections, their
+// bodies and the elements of those, so only nodes with errors in them are
+// looked inside apart from those.
+static void extract(Document *doc, const Symbols *symbols, const TSTree *tree, const char *text) {
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+    for (;;) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        TSSymbol symbol = ts_node_symbol(node);
+
+        if (ts_node_is_missing(node) || symbol == ERROR_SYMBOL) doc->errors++;
+        if (symbol == symbols->heading) add_heading(doc, symbols, node, text);
+        else if (symbol == symbols->keyword) add_keyword(doc, node, text);
+
+        bool descend = symbol == symbols->document || symbol == symbols->section ||
+                       symbol == symbols->body || symbol == symbols->element ||
+                       ts_node_has_error(node);
+        if (descend && ts_tree_cursor_goto_first_child(&cursor)) continue;
+
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ts_tree_cursor_delete(&cursor);
+                return;
+            }
+        }
+    }
+}
+
+static void parse(Document *doc, TSParser *parser, const Symbols *symbols, const char *text, size_t length) {
+    if (length > UINT32_MAX) {
+        doc->error = EFBIG;
+        return;
+    }
+    TSTree *tree = ts_parser_parse_string(parser, NULL, text != NULL ? text : "", (uint32_t) length);
+    if (tree == NULL) {
+        doc->failed = true;
+        return;
+    }
+    extract(doc, symbols, tree, text);
+    ts_tree_delete(tree);
+}
+
+// where files can't be mapped, they're read into memory instead
+static void parse_read_file(Document *doc, TSParser *parser, const Symbols *symbols) {
+    FILE *file = fopen(doc->path, "rb");
+    if (file == NULL) {
+        doc->error = errno;
+        return;
+    }
+    Array(char) text = array_new();
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) array_extend(&text, (uint32_t) n, chunk);
+    if (ferror(file)) doc->error = EIO;
+    else parse(doc, parser, symbols, text.contents, text.size);
+    fclose(file);
+    array_delete(&text);
+}
+
+static void parse_document(void *context, unsigned worker, uint32_t index) {
+    Batch *batch = context;
+    Document *doc = &batch->documents[index];
+
+    if (batch->parsers[worker] == NULL) {
+        TSParser *parser = ts_parser_new();
+        if (!ts_parser_set_language(parser, tree_sitter_orgmode())) {
+            ts_parser_delete(parser);
+            doc->failed = true;
+            return;
+        }
+        batch->parsers[worker] = parser;
+    }
+    TSParser *parser = batch->parsers[worker];
+
+    if (doc->path == NULL) {
+        parse(doc, parser, batch->symbols, doc->text, doc->length);
+        return;
+    }
+
+    TSOrgmodeMappedFile file;
+    if (tree_sitter_orgmode_mapped_file_open(&file, doc->path)) {
+        parse(doc, parser, batch->symbols, file.data, file.size);
+        tree_sitter_orgmode_mapped_file_close(&file);
+    } else if (errno == ENOSYS) {
+        parse_read_file(doc, parser, batch->symbols);
+    } else {
+        doc->error = errno;
+    }
+}
+
+static PyObject *decode(const Document *doc, Slice slice) {
+    if (slice.length == 0) return PyUnicode_FromStringAndSize("", 0);
+    return PyUnicode_DecodeUTF8(doc->strings.contents + slice.start, slice.length, "replace");
+}
+
+// (headings, keywords, errors), with each heading a (level, title, row) and
+// each keyword a (key, value, row)
+static PyObject *document_result(const Document *doc) {
+    PyObject *headings = PyTuple_New(doc->headings.size);
+    PyObject *keywords = PyTuple_New(doc->keywords.size);
+    if (headings == NULL || keywords == NULL) goto error;
+
+    for (uint32_t i = 0; i < doc->headings.size; i++) {
+        const Heading *h = &doc->headings.contents[i];
+        PyObject *title = decode(doc, h->title);
+        if (title == NULL) goto error;
+        PyObject *heading = Py_BuildValue("(INI)", h->level, title, h->row);
+        if (heading == NULL) goto error;
+        PyTuple_SetItem(headings, i, heading);
+    }
+
+    for (uint32_t i = 0; i < doc->keywords.size; i++) {
+        const Keyword *k = &doc->keywords.contents[i];
+        PyObject *key = decode(doc, k->key);
+        if (key == NULL) goto error;
+        PyObject *value = decode(doc, k->value);
+        if (value == NULL) {
+            Py_DECREF(key);
+            goto error;
+        }
+        PyObject *keyword = Py_BuildValue("(NNI)", key, value, k->row);
+        if (keyword == NULL) goto error;
+        PyTuple_SetItem(keywords, i, keyword);
+    }
+
+    return Py_BuildValue("(NNI)", headings, keywords, doc->errors);
+
+error:
+    Py_XDECREF(headings);
+    Py_XDECREF(keywords);
+    return NULL;
+}
+
+static TSSymbol symbol_for_name(const TSLanguage *language, const char *name) {
+    return ts_language_symbol_for_name(language, name, (uint32_t) strlen(name), true);
+}
+
+static PyObject *_binding_parse_many(PyObject *Py_UNUSED(self), PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"sources", "threads", NULL};
+    PyObject *sources;
+    unsigned threads = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|I:parse_many", keywords, &sources, &threads)) {
+        return NULL;
+    }
+
+    Py_ssize_t count = PySequence_Size(sources);
+    if (count < 0) return NULL;
+    if ((size_t) count > UINT32_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "too many sources");
+        return NULL;
+    }
+
+    // the bytes of every path and a view of every buffer, held on to until
+    // the parses are done
+    PyObject *held = PyList_New(count);
+    Py_buffer *views = PyMem_Calloc(count > 0 ? count : 1, sizeof(Py_buffer));
+    Document *documents = PyMem_Calloc(count > 0 ? count : 1, sizeof(Document));
+    PyObject *result = NULL;
+    if (held == NULL || views == NULL || documents == NULL) {
+        if (held != NULL) PyErr_NoMemory();
+        goto done;
+    }
+
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject *source = PySequence_GetItem(sources, i);
+        if (source == NULL) goto done;
+
+        // bytes, bytearray, memoryview, mmap and the like are the text itself
+        if (PyObject_CheckBuffer(source)) {
+            int viewed = PyObject_GetBuffer(source, &views[i], PyBUF_SIMPLE);
+            Py_DECREF(source);
+            if (viewed < 0) goto done;
+            documents[i].text = views[i].buf;
+            documents[i].length = (size_t) views[i].len;
+            continue;
+        }
+
+        PyObject *path;
+        int converted = PyUnicode_FSConverter(source, &path);
+        Py_DECREF(source);
+        if (!converted) goto done;
+        PyList_SetItem(held, i, path);
+        documents[i].path = PyBytes_AsString(path);
+        if (documents[i].path == NULL) goto done;
+    }
+
+    const TSLanguage *language = tree_sitter_orgmode();
+    Symbols symbols = {
+        .document = symbol_for_name(language, "document"),
+        .section = symbol_for_name(language, "section"),
+        .body = symbol_for_name(language, "body"),
+        .element = symbol_for_name(language, "element"),
+        .heading = symbol_for_name(language, "heading"),
+        .keyword = symbol_for_name(language, "keyword"),
+        .title = ts_language_field_id_for_name(language, "title", (uint32_t) strlen("title")),
+    };
+
+    if (threads == 0) threads = tree_sitter_orgmode_cpu_count();
+    if (threads > (unsigned) count) threads = count > 0 ? (unsigned) count : 1;
+    Batch batch = {documents, PyMem_Calloc(threads, sizeof(TSParser *)), &symbols};
+    if (batch.parsers == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    bool ran;
+    Py_BEGIN_ALLOW_THREADS
+    ran = tree_sitter_orgmode_run_parallel(threads, (uint32_t) count, parse_document, &batch);
+    for (unsigned i = 0; i < threads; i++) {
+        if (batch.parsers[i] != NULL) ts_parser_delete(batch.parsers[i]);
+    }
+    Py_END_ALLOW_THREADS
+    PyMem_Free(batch.parsers);
+
+    if (!ran) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    // any source that couldn't be parsed fails the lot, as one bad file
+    // would stop a loop over them
+    for (Py_ssize_t i = 0; i < count; i++) {
+        const Document *doc = &documents[i];
+        if (doc->error != 0) {
+            errno = doc->error;
+            PyObject *source = doc->path != NULL ? PySequence_GetItem(sources, i) : NULL;
+            if (source != NULL) {
+                PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, source);
+                Py_DECREF(source);
+            } else {
+                PyErr_SetFromErrno(PyExc_OSError);
+            }
+            goto done;
+        }
+        if (doc->failed) {
+            PyErr_Format(PyExc_RuntimeError, "couldn't parse source %zd", i);
+            goto done;
+        }
+    }
+
+    result = PyList_New(count);
+    for (Py_ssize_t i = 0; result != NULL && i < count; i++) {
+        PyObject *item = document_result(&documents[i]);
+        if (item == NULL) Py_CLEAR(result);
+        else PyList_SetItem(result, i, item);
+    }
+
+done:
+    for (Py_ssize_t i = 0; documents != NULL && i < count; i++) {
+        array_delete(&documents[i].headings);
+        array_delete(&documents[i].keywords);
+        array_delete(&documents[i].strings);
+    }
+    for (Py_ssize_t i = 0; views != NULL && i < count; i++) {
+        if (views[i].obj != NULL) PyBuffer_Release(&views[i]);
+    }
+    PyMem_Free(documents);
+    PyMem_Free(views);
+    Py_XDECREF(held);
+    return result;
 }
 
 static struct PyModuleDef_Slot slots[] = {
@@ -18,6 +380,8 @@ static struct PyModuleDef_Slot slots[] = {
 static PyMethodDef methods[] = {
     {"language", _binding_language, METH_NOARGS,
      "Get the tree-sitter language for this grammar."},
+    {"parse_many", (PyCFunction) (void (*)(void)) _binding_parse_many, METH_VARARGS | METH_KEYWORDS,
+     "Parse many org documents in parallel, without holding the GIL."},
     {NULL, NULL, 0, NULL}
 };
 
@@ -0,0 +1,61 @@
+//! How indexing a directory of org files scales with the number of threads.
+//!
+//!     cargo bench --features index --bench index
+
+use std::fs;
+use std::path::PathBuf;
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use tree_sitter_orgmode::index::{index_files, org_files};
+
+const FILES: usize = 256;
+
+fn document(seed: usize) -> String {
+    let mut text = format!("#+TITLE: Notes {seed}\n\n");
+    for i in 0..40 {
+        let todo = ["", "TODO ", "DONE "][(seed + i) % 3];
+        text += &format!("* {todo}[#B] Heading {i}\n:PROPERTIES:\n:ID: {seed}-{i}\n:END:\n");
+        text += "Some *bold* text with a [[https://orgmode.org][link]] in it.\n\n";
+        for j in 0..3 {
+            text += &format!("** Subheading {j}\n- an item\n- another\n  1. nested\n\n");
+        }
+    }
+    text
+}
+
+fn bench_index(c: &mut Criterion) {
+    let dir = std::env::temp_dir().join(format!("orgmode-index-bench-{}", std::process::id()));
+    let mut bytes = 0;
+    for i in 0..FILES {
+        let sub = dir.join(format!("{}", i % 8));
+        fs::create_dir_all(&sub).unwrap();
+        let text = document(i);
+        bytes += text.len() as u64;
+        fs::write(sub.join(format!("{i}.org")), text).unwrap();
+    }
+    let (files, failed): (Vec<PathBuf>, _) = org_files([&dir]);
+    assert!(failed.is_empty());
+
+    let cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+    let mut threads = vec![1];
+    while threads.last().unwrap() * 2 < cores {
+        threads.push(threads.last().unwrap() * 2);
+    }
+    if cores > 1 {
+        threads.push(cores);
+    }
+
+    let mut group = c.benchmark_group("index");
+    group.throughput(Throughput::Bytes(bytes));
+    for n in threads {
+        group.bench_with_input(BenchmarkId::from_parameter(n), &n, |b, &n| {
+            b.iter(|| index_files(&files, n))
+        });
+    }
+    group.finish();
+
+    fs::remove_dir_all(&dir).unwrap();
+}
+
+criterion_group!(benches, bench_index);
+criterion_main!(benches);
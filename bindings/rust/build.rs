@@ -17,5 +17,12 @@ fn main() {
         println!("cargo:rerun-if-changed={}", scanner_path.to_str().unwrap());
     }
 
+    // the rest of what the C header declares
+    for name in ["outline.c", "sections.c", "parallel.c", "input.c", "section_table.c"] {
+        let path = src_dir.join(name);
+        c_config.file(&path);
+        println!("cargo:rerun-if-changed={}", path.to_str().unwrap());
+    }
+
     c_config.compile("tree-sitter-orgmode");
 }
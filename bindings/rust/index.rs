@@ -0,0 +1,295 @@
+//! Outlines of many org files at once, parsed in parallel.
+//!
+//! [`index`] takes files and directories, finds the org files under the
+//! directories, and parses them on a pool of threads, each with a
+//! [`Parser`] of its own. Files are mapped into memory rather than read.
+//!
+//! ```no_run
+//! for file in tree_sitter_orgmode::index::index(["notes"], 0) {
+//!     let outline = file.outline.expect("couldn't read the file");
+//!     for heading in outline.headings {
+//!         println!("{} {:?}", file.path.display(), heading.byte_range);
+//!     }
+//! }
+//! ```
+
+use std::fs::{self, File};
+use std::io;
+use std::ops::Range;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::thread;
+
+use memmap2::Mmap;
+use tree_sitter::{Language, Parser, TreeCursor};
+
+/// A heading's TODO keyword.
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
+pub enum Todo {
+    Todo,
+    Done,
+}
+
+/// A heading, and the section it starts.
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub struct Heading {
+    /// The number of stars.
+    pub level: u32,
+    /// The whole section, up to the next heading of this level or higher.
+    pub byte_range: Range<usize>,
+    pub todo: Option<Todo>,
+    /// The letter or digit in a `[#A]` priority cookie.
+    pub priority: Option<u8>,
+    pub title: Option<Range<usize>>,
+}
+
+/// The headings of a document, in the order they start in.
+#[derive(Clone, Debug, Default, PartialEq, Eq)]
+pub struct Outline {
+    pub headings: Vec<Heading>,
+    /// Whether the tree had any errors in it, in which case the outline may
+    /// be missing headings.
+    pub has_error: bool,
+}
+
+/// A file [`index`] parsed, or couldn't.
+#[derive(Debug)]
+pub struct IndexedFile {
+    pub path: PathBuf,
+    pub outline: io::Result<Outline>,
+}
+
+struct Kinds {
+    section: u16,
+    keyword: u16,
+    cookie: u16,
+}
+
+impl Kinds {
+    fn new(language: &Language) -> Self {
+        Self {
+            section: language.id_for_node_kind("section", true),
+            keyword: language.id_for_node_kind("keyword", false),
+            cookie: language.id_for_node_kind("cookie", false),
+        }
+    }
+}
+
+fn new_parser() -> Parser {
+    let mut parser = Parser::new();
+    parser
+        .set_language(&crate::LANGUAGE.into())
+        .expect("Error loading org mode parser");
+    parser
+}
+
+/// Parses `text` and finds its headings, or returns `None` if the parse was
+/// cancelled. `parser` has to be set to this language.
+pub fn outline(parser: &mut Parser, text: &[u8]) -> Option<Outline> {
+    let tree = parser.parse(text, None)?;
+    let kinds = Kinds::new(&tree.language());
+    let mut outline = Outline {
+        headings: Vec::new(),
+        has_error: tree.root_node().has_error(),
+    };
+    collect_headings(&mut tree.walk(), &kinds, text, &mut outline.headings);
+    Some(outline)
+}
+
+// Headings are only ever at the start of sections, which are only in the
+// document and other sections, so the rest of the tree is never looked at.
+fn collect_headings(cursor: &mut TreeCursor, kinds: &Kinds, text: &[u8], headings: &mut Vec<Heading>) {
+    if !cursor.goto_first_child() {
+        return;
+    }
+    loop {
+        let section = cursor.node();
+        if section.kind_id() == kinds.section {
+            if let Some(heading) = section.child(0) {
+                let mut found = Heading {
+                    level: 0,
+                    byte_range: section.byte_range(),
+                    todo: None,
+                    priority: None,
+                    title: heading.child_by_field_name("title").map(|title| title.byte_range()),
+                };
+                let mut children = heading.walk();
+                for (i, child) in heading.children(&mut children).enumerate() {
+                    if i == 0 {
+                        found.level = (child.end_byte() - child.start_byte()) as u32;
+                    } else if child.kind_id() == kinds.keyword {
+                        found.todo = match &text[child.byte_range()] {
+                            b"TODO" => Some(Todo::Todo),
+                            b"DONE" => Some(Todo::Done),
+                            _ => None,
+                        };
+                    } else if child.kind_id() == kinds.cookie {
+                        found.priority = text.get(child.start_byte() + 2).copied();
+                    }
+                }
+                headings.push(found);
+            }
+            collect_headings(cursor, kinds, text, headings);
+        }
+        if !cursor.goto_next_sibling() {
+            break;
+        }
+    }
+    cursor.goto_parent();
+}
+
+fn outline_file(parser: &mut Parser, path: &Path) -> io::Result<Outline> {
+    let file = File::open(path)?;
+    let cancelled = || io::Error::new(io::ErrorKind::Interrupted, "the parse was cancelled");
+
+    // there's nothing to map in an empty file
+    if file.metadata()?.len() == 0 {
+        return outline(parser, b"").ok_or_else(cancelled);
+    }
+    // SAFETY: the mapping is only read while it's parsed, and a file that's
+    // changed meanwhile can only make the outline wrong
+    let text = unsafe { Mmap::map(&file)? };
+    outline(parser, &text).ok_or_else(cancelled)
+}
+
+/// Parses each of `files` on `threads` threads, or one for each CPU if it's
+/// 0, and returns their outlines in the same order.
+pub fn index_files(files: &[PathBuf], threads: usize) -> Vec<IndexedFile> {
+    let threads = match threads {
+        0 => thread::available_parallelism().map_or(1, |n| n.get()),
+        n => n,
+    }
+    .min(files.len())
+    .max(1);
+
+    // files are handed out one at a time, so a thread that gets small ones
+    // just takes more of them
+    let next = AtomicUsize::new(0);
+    let mut outlines: Vec<(usize, io::Result<Outline>)> = thread::scope(|scope| {
+        let workers: Vec<_> = (0..threads)
+            .map(|_| {
+                scope.spawn(|| {
+                    let mut parser = new_parser();
+                    let mut done = Vec::new();
+                    loop {
+                        let i = next.fetch_add(1, Ordering::Relaxed);
+                        let Some(path) = files.get(i) else { break };
+                        done.push((i, outline_file(&mut parser, path)));
+                    }
+                    done
+                })
+            })
+            .collect();
+        workers
+            .into_iter()
+            .flat_map(|worker| worker.join().expect("an indexing thread panicked"))
+            .collect()
+    });
+
+    outlines.sort_unstable_by_key(|(i, _)| *i);
+    files
+        .iter()
+        .zip(outlines)
+        .map(|(path, (_, outline))| IndexedFile {
+            path: path.clone(),
+            outline,
+        })
+        .collect()
+}
+
+/// Finds the files to index under `paths`: the `.org` files under each
+/// directory, in sorted order and without following symbolic links to other
+/// directories, and any other path as it is. A directory that can't be read
+/// is given back as an error.
+pub fn org_files<P: AsRef<Path>>(paths: impl IntoIterator<Item = P>) -> (Vec<PathBuf>, Vec<IndexedFile>) {
+    let mut files = Vec::new();
+    let mut failed = Vec::new();
+    for path in paths {
+        let path = path.as_ref();
+        match fs::metadata(path) {
+            Ok(metadata) if metadata.is_dir() => walk_dir(path, &mut files, &mut failed),
+            _ => files.push(path.to_path_buf()),
+        }
+    }
+    (files, failed)
+}
+
+fn walk_dir(dir: &Path, files: &mut Vec<PathBuf>, failed: &mut Vec<IndexedFile>) {
+    let entries = match fs::read_dir(dir).and_then(|entries| entries.collect::<io::Result<Vec<_>>>()) {
+        Ok(entries) => entries,
+        Err(error) => {
+            failed.push(IndexedFile {
+                path: dir.to_path_buf(),
+                outline: Err(error),
+            });
+            return;
+        }
+    };
+
+    let mut paths: Vec<_> = entries
+        .into_iter()
+        .filter_map(|entry| Some((entry.path(), entry.file_type().ok()?)))
+        .collect();
+    paths.sort_unstable_by(|(a, _), (b, _)| a.cmp(b));
+    for (path, file_type) in paths {
+        if file_type.is_dir() {
+            walk_dir(&path, files, failed);
+        } else if path.extension().is_some_and(|extension| extension == "org") {
+            files.push(path);
+        }
+    }
+}
+
+/// Indexes every org file under `paths` (see [`org_files`]) on `threads`
+/// threads, or one for each CPU if it's 0. Directories that couldn't be
+/// read come first, then the files in the order they were found.
+pub fn index<P: AsRef<Path>>(paths: impl IntoIterator<Item = P>, threads: usize) -> Vec<IndexedFile> {
+    let (files, mut indexed) = org_files(paths);
+    indexed.extend(index_files(&files, threads));
+    indexed
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const TEXT: &[u8] = b"* TODO [#A] First\nText.\n** DONE Second\n* Third\n";
+
+    #[test]
+    fn test_outline() {
+        let outline = outline(&mut new_parser(), TEXT).unwrap();
+        assert!(!outline.has_error);
+        let headings: Vec<_> = outline
+            .headings
+            .iter()
+            .map(|h| (h.level, h.todo, h.priority, &TEXT[h.title.clone().unwrap()]))
+            .collect();
+        assert_eq!(headings.len(), 3);
+        assert_eq!((headings[0].0, headings[0].1, headings[0].2), (1, Some(Todo::Todo), Some(b'A')));
+        assert_eq!((headings[1].0, headings[1].1), (2, Some(Todo::Done)));
+        assert_eq!((headings[2].0, headings[2].1), (1, None));
+        assert!(String::from_utf8_lossy(headings[0].3).contains("First"));
+        assert_eq!(outline.headings[0].byte_range.start, 0);
+        assert_eq!(outline.headings[2].byte_range.end, TEXT.len());
+    }
+
+    #[test]
+    fn test_index_matches_outline() {
+        let dir = std::env::temp_dir().join(format!("orgmode-index-test-{}", std::process::id()));
+        fs::create_dir_all(dir.join("nested")).unwrap();
+        for i in 0..16 {
+            let sub = if i % 2 == 0 { dir.clone() } else { dir.join("nested") };
+            fs::write(sub.join(format!("{i}.org")), TEXT).unwrap();
+        }
+        fs::write(dir.join("ignored.txt"), b"* not org").unwrap();
+
+        let indexed = index([&dir], 4);
+        fs::remove_dir_all(&dir).unwrap();
+
+        let expected = outline(&mut new_parser(), TEXT).unwrap();
+        assert_eq!(indexed.len(), 16);
+        for file in indexed {
+            assert_eq!(file.outline.unwrap(), expected, "{}", file.path.display());
+        }
+    }
+}
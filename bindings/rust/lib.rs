@@ -20,6 +20,9 @@
 
 use tree_sitter_language::LanguageFn;
 
+#[cfg(feature = "index")]
+pub mod index;
+
 extern "C" {
     fn tree_sitter_orgmode() -> *const ();
 }
@@ -32,10 +35,18 @@ pub const LANGUAGE: LanguageFn = unsafe { LanguageFn::from_raw(tree_sitter_orgmo
 /// [`node-types.json`]: https://tree-sitter.github.io/tree-sitter/using-parsers/6-static-node-types
 pub const NODE_TYPES: &str = include_str!("../../src/node-types.json");
 
+/// The syntax highlighting query for this grammar.
+pub const HIGHLIGHTS_QUERY: &str = include_str!("../../queries/highlights.scm");
+
+/// The language injection query for this grammar, which parses the bodies of
+/// src and export blocks in the language they name.
+pub const INJECTIONS_QUERY: &str = include_str!("../../queries/injections.scm");
+
+/// The folding query for this grammar: sections, blocks and drawers.
+pub const FOLDS_QUERY: &str = include_str!("../../queries/folds.scm");
+
 // NOTE: uncomment these to include any queries that this grammar contains:
 
-// pub const HIGHLIGHTS_QUERY: &str = include_str!("../../queries/highlights.scm");
-// pub const INJECTIONS_QUERY: &str = include_str!("../../queries/injections.scm");
 // pub const LOCALS_QUERY: &str = include_str!("../../queries/locals.scm");
 // pub const TAGS_QUERY: &str = include_str!("../../queries/tags.scm");
 
@@ -48,4 +59,12 @@ mod tests {
             .set_language(&super::LANGUAGE.into())
             .expect("Error loading org mode parser");
     }
+
+    #[test]
+    fn test_queries_compile() {
+        let language = super::LANGUAGE.into();
+        for query in [super::HIGHLIGHTS_QUERY, super::INJECTIONS_QUERY, super::FOLDS_QUERY] {
+            tree_sitter::Query::new(&language, query).expect("Error compiling a query");
+        }
+    }
 }
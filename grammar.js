@@ -47,6 +47,7 @@ export default grammar({
     $.pathreg,
     $.comment_line,
     $._nl,
+    $.raw_body, // the contents of src, example, export and comment blocks
     $.error_sentinel,
   ],
 
@@ -54,8 +55,10 @@ export default grammar({
     /[ \t]+/
   ],
 
-  conflicts: $ => [
-    [$._minimal_set, $.value],
+  // substituted where they're used, so they never need reducing on their
+  // own
+  inline: $ => [
+    $._interrupted_word,
   ],
 
   rules: {
@@ -76,28 +79,10 @@ export default grammar({
       $._blank_line,
     )),
 
-    incomplete_element: $ => prec(-1, choice(
-      seq(
-        $._block_begin_marker,
-        $.block_begin_name,
-        optional(seq(
-          $._space, field("params", $.value)
-        )),
-        $._blank_line,
-        optional(seq(
-          field("body", alias(repeat($.element), "body")),
-        )),
-      )
-    )),
-
     body: $ => prec.left(0, seq(
       repeat1($.element)
     )),
 
-    greater_element: $ => choice(
-      $.greater_block
-    ),
-
     section: $ => seq(
       $.heading,
       optional($.body),
@@ -128,9 +113,10 @@ export default grammar({
         $.value,
         $._nl,
       ))),
-      field("body", optional(seq(
-        alias(repeat($.element), "body")),
-      )),
+      field("body", optional(choice(
+        seq(alias(repeat($.element), "body")),
+        $.raw_body,
+      ))),
       optional(seq(
         $._block_end_marker,
         $.block_end_name,
@@ -216,22 +202,25 @@ export default grammar({
     ),
 
     // needed because, due to the $.start rules, these would not otherwise
-    // constitute valid words.
+    // constitute valid words. the objects after one are part of it so that
+    // markup that's never closed falls back to this without a conflict.
     _interrupted_start: $ => prec.left(-1, seq(
-      choice(
-        alias($.stars, $.word),
-        alias($._bold_start, $.word),
-        alias($._italic_start, $.word),
-        alias($._underline_start, $.word),
-        alias($._verbatim_start, $.word),
-        alias($._code_inline_start, $.word),
-        alias($._strikethrough_start, $.word),
-        alias($._link_start, $.word),
-        alias($._link_end, $.word),
-      ),
+      alias($._interrupted_word, $.word),
       repeat($._object)
     )),
 
+    _interrupted_word: $ => choice(
+      $.stars,
+      $._bold_start,
+      $._italic_start,
+      $._underline_start,
+      $._verbatim_start,
+      $._code_inline_start,
+      $._strikethrough_start,
+      $._link_start,
+      $._link_end,
+    ),
+
     bold: $ => seq($._bold_start, repeat1($._object), $._bold_end),
     italic: $ => seq($._italic_start, repeat1($._object), $._italic_end),
     underline: $ => seq($._underline_start, repeat1($._object), $._underline_end),
@@ -242,6 +231,8 @@ export default grammar({
     _blank_line: $ => /\r?\n[ \t]*/,
     _space: $ => /[ \t]+/,
     // value: $ => /[^\n]+/,
-    value: $ => prec.right(repeat1($.word)),
+    // the first word is above a paragraph's, so a block's first line is its
+    // params rather than the start of its body
+    value: $ => prec.right(1, seq($.word, repeat($.word))),
   }
 });
@@ -0,0 +1,6 @@
+[
+  (section)
+  (greater_block)
+  (dynamic_block)
+  (drawer)
+] @fold
@@ -0,0 +1,76 @@
+; Every pattern names the node types it captures, so matching only visits
+; the nodes that can be highlighted; nothing matches word on its own, the
+; most common node in any document.
+
+; Headings
+
+(heading (stars) @punctuation.special)
+
+(heading "keyword" @keyword)
+
+(heading "cookie" @attribute)
+
+(heading "COMMENT" @comment)
+
+(heading title: _ @markup.heading)
+
+; Markup
+
+(bold) @markup.strong
+
+(italic) @markup.italic
+
+(underline) @markup.underline
+
+(strikethrough) @markup.strikethrough
+
+[
+  (verbatim)
+  (code_inline)
+] @markup.raw
+
+; Links
+
+(regular_link pathreg: (pathreg) @markup.link.url)
+
+(regular_link description: _ @markup.link.label)
+
+; Keywords, blocks and drawers
+
+(keyword (keyword_key) @keyword.directive)
+
+(keyword (value) @string)
+
+[
+  (block_begin_name)
+  (block_end_name)
+  "#+begin:"
+  "#+end:"
+] @keyword.directive
+
+(greater_block params: (value) @variable.parameter)
+
+(dynamic_block params: (value) @variable.parameter)
+
+(raw_body) @markup.raw.block
+
+[
+  (drawer_name)
+  (drawer_end)
+] @label
+
+(node_property name: (property_name) @property)
+
+(node_property value: (value) @string)
+
+; Lists
+
+(bullet) @markup.list
+
+((checkbox) @markup.list.checked
+  (#eq? @markup.list.checked "[X]"))
+
+((checkbox) @markup.list.unchecked
+  (#any-of? @markup.list.unchecked "[ ]" "[-]"))
+
+(comment_line) @comment
@@ -0,0 +1,10 @@
+; A src block's body is parsed in the language its parameters start with,
+; and an export block's in the backend it names. Each body is injected on
+; its own, so only the blocks in view are ever parsed, and an injected
+; parser never sees past the end of its block.
+
+((greater_block
+  (block_begin_name) @_name
+  params: (value . (word) @injection.language)
+  body: (raw_body) @injection.content)
+  (#any-of? @_name "src" "SRC" "export" "EXPORT"))
@@ -1,12 +1,23 @@
 from os import path
+from sys import version_info
 from sysconfig import get_config_var
 
 from setuptools import Extension, find_packages, setup
 from setuptools.command.build import build
 from setuptools.command.build_ext import build_ext
 from setuptools.command.egg_info import egg_info
+from setuptools.errors import SetupError
 from wheel.bdist_wheel import bdist_wheel
 
+# the tree-sitter runtime's sources, which `make vendor` fetches. parse_many
+# parses on threads of its own, and the tree_sitter package keeps its
+# runtime's symbols to itself, so the extension is built with a copy.
+RUNTIME = path.join("vendor", "tree-sitter", "lib")
+
+# parse_many takes any buffer, and the buffer protocol is only in the limited
+# API from 3.11
+LIMITED_API = not get_config_var("Py_GIL_DISABLED") and version_info >= (3, 11)
+
 
 class Build(build):
     def run(self):
@@ -24,16 +35,22 @@ class BuildExt(build_ext):
             ext.extra_compile_args = ["/std:c11", "/utf-8"]
         if path.exists("src/scanner.c"):
             ext.sources.append("src/scanner.c")
+        if self.compiler.compiler_type != "msvc":
+            ext.extra_link_args = ["-lpthread"]
+        if not path.exists(path.join(RUNTIME, "src", "lib.c")):
+            raise SetupError(f"the tree-sitter runtime isn't in {RUNTIME}; run `make vendor` to fetch it")
+        ext.sources.append(path.join(RUNTIME, "src", "lib.c"))
+        ext.include_dirs.append(path.join(RUNTIME, "include"))
         if ext.py_limited_api:
-            ext.define_macros.append(("Py_LIMITED_API", "0x030A0000"))
+            ext.define_macros.append(("Py_LIMITED_API", "0x030B0000"))
         super().build_extension(ext)
 
 
 class BdistWheel(bdist_wheel):
     def get_tag(self):
         python, abi, platform = super().get_tag()
-        if python.startswith("cp"):
-            python, abi = "cp310", "abi3"
+        if LIMITED_API and python.startswith("cp"):
+            python, abi = "cp311", "abi3"
         return python, abi, platform
 
 
@@ -42,6 +59,10 @@ class EggInfo(egg_info):
         super().find_sources()
         self.filelist.recursive_include("queries", "*.scm")
         self.filelist.include("src/tree_sitter/*.h")
+        self.filelist.include("bindings/c/tree_sitter/*.h")
+        self.filelist.include("vendor/tree-sitter/LICENSE")
+        self.filelist.graft("vendor/tree-sitter/lib/include")
+        self.filelist.graft("vendor/tree-sitter/lib/src")
 
 
 setup(
@@ -58,13 +79,21 @@ setup(
             sources=[
                 "bindings/python/tree_sitter_orgmode/binding.c",
                 "src/parser.c",
+                # the rest of what the C header declares
+                "src/outline.c",
+                "src/sections.c",
+                "src/parallel.c",
+                "src/input.c",
+                "src/section_table.c",
             ],
             define_macros=[
                 ("PY_SSIZE_T_CLEAN", None),
                 ("TREE_SITTER_HIDE_SYMBOLS", None),
+                # for the runtime's use of POSIX and BSD functions under c11
+                ("_DEFAULT_SOURCE", None),
             ],
-            include_dirs=["src"],
-            py_limited_api=not get_config_var("Py_GIL_DISABLED"),
+            include_dirs=["src", "bindings/c"],
+            py_limited_api=LIMITED_API,
         )
     ],
     cmdclass={
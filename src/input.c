@@ -0,0 +1,169 @@
+// Reading documents for the parser straight from files, either mapped into
+// memory or streamed a chunk at a time. tree-sitter-orgmode-runtime.h wraps
+// these in TSInputs.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "tree_sitter/alloc.h"
+
+#include "../bindings/c/tree_sitter/tree-sitter-orgmode.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// a stream's chunks must be able to hold any character whole
+#define MIN_CHUNK_SIZE 4
+
+// tree-sitter counts bytes in 32 bits, so nothing past this is ever read
+#define MAX_INPUT_SIZE UINT32_MAX
+
+#ifndef _WIN32
+
+bool tree_sitter_orgmode_mapped_file_open(TSOrgmodeMappedFile *file, const char *path) {
+    file->data = NULL;
+    file->size = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+
+    // mapping nothing is an error, so an empty file has no mapping at all
+    if (st.st_size > 0) {
+        void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            int error = errno;
+            close(fd);
+            errno = error;
+            return false;
+        }
+        file->data = data;
+        file->size = (size_t) st.st_size;
+    }
+
+    // the mapping outlives the descriptor
+    close(fd);
+    return true;
+}
+
+void tree_sitter_orgmode_mapped_file_close(TSOrgmodeMappedFile *file) {
+    if (file->data != NULL) munmap((void *) file->data, file->size);
+    file->data = NULL;
+    file->size = 0;
+}
+
+#else
+
+bool tree_sitter_orgmode_mapped_file_open(TSOrgmodeMappedFile *file, const char *path) {
+    (void) path;
+    file->data = NULL;
+    file->size = 0;
+    errno = ENOSYS;
+    return false;
+}
+
+void tree_sitter_orgmode_mapped_file_close(TSOrgmodeMappedFile *file) {
+    file->data = NULL;
+    file->size = 0;
+}
+
+#endif
+
+// the rest of the file from `byte_index`, without copying any of it. as it's
+// all there, no character is ever split.
+const char *tree_sitter_orgmode_mapped_file_read(void *payload, uint32_t byte_index, uint32_t *bytes_read) {
+    const TSOrgmodeMappedFile *file = payload;
+    size_t size = file->size < MAX_INPUT_SIZE ? file->size : MAX_INPUT_SIZE;
+    if (byte_index >= size) {
+        *bytes_read = 0;
+        return "";
+    }
+    *bytes_read = (uint32_t) (size - byte_index);
+    return file->data + byte_index;
+}
+
+bool tree_sitter_orgmode_file_stream_init(TSOrgmodeFileStream *stream, int fd, uint32_t chunk_size) {
+    if (chunk_size < MIN_CHUNK_SIZE) chunk_size = MIN_CHUNK_SIZE;
+    stream->fd = fd;
+    stream->failed = false;
+    stream->error = 0;
+    stream->chunk_size = chunk_size;
+    stream->buffer = ts_malloc(chunk_size);
+    if (stream->buffer == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+    return true;
+}
+
+void tree_sitter_orgmode_file_stream_delete(TSOrgmodeFileStream *stream) {
+    ts_free(stream->buffer);
+    stream->buffer = NULL;
+}
+
+// how many bytes at the end of `chunk` begin a character which runs on past
+// it. those are left for the next chunk, so tree-sitter never sees a
+// character cut in two.
+static uint32_t split_character_length(const unsigned char *chunk, uint32_t length) {
+    for (uint32_t back = 1; back < MIN_CHUNK_SIZE && back <= length; back++) {
+        unsigned char c = chunk[length - back];
+        if ((c & 0xc0) == 0x80) continue;
+
+        // anything that can't start a character is a character of its own
+        uint32_t needs = c >= 0xf8 ? 1 : c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : c >= 0xc0 ? 2 : 1;
+        return needs > back ? back : 0;
+    }
+    return 0;
+}
+
+const char *tree_sitter_orgmode_file_stream_read(void *payload, uint32_t byte_index, uint32_t *bytes_read) {
+    TSOrgmodeFileStream *stream = payload;
+    *bytes_read = 0;
+    if (stream->failed) return "";
+
+#ifndef _WIN32
+    // reads are positioned, since the parser goes back over text it's
+    // already had when it has to
+    uint32_t length = 0;
+    while (length < stream->chunk_size) {
+        ssize_t n = pread(stream->fd, stream->buffer + length, stream->chunk_size - length,
+                          (off_t) byte_index + length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            stream->failed = true;
+            stream->error = errno;
+            return "";
+        }
+        if (n == 0) break;
+        length += (uint32_t) n;
+    }
+
+    // a short chunk is the end of the file, so there's nothing to keep back
+    if (length == stream->chunk_size) {
+        length -= split_character_length((const unsigned char *) stream->buffer, length);
+    }
+    if ((uint64_t) byte_index + length > MAX_INPUT_SIZE) length = MAX_INPUT_SIZE - byte_index;
+
+    *bytes_read = length;
+    return stream->buffer;
+#else
+    (void) byte_index;
+    stream->failed = true;
+    stream->error = ENOSYS;
+    return "";
+#endif
+}
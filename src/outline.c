@@ -0,0 +1,503 @@
+// The outline of an org document, its headings, blocks and drawers, found
+// without parsing it. Every line is judged the way the external scanner
+// would judge it at the start of an element: headings as in scan_stars,
+// block bodies as in scan_raw_body, and block and drawer names as scan does.
+// bench/outline_bench.c checks that this finds what the parser does.
+//
+// Only lines starting with '*', '#', ':', a blank or a non-ASCII byte can
+// matter. They're found 64 bytes at a time, with AVX2 or SSE2 where there
+// are, from a mask of the newlines and a mask of the bytes which can start
+// such a line, so the text in between is never looked at one byte at a time.
+// Defining ORGMODE_OUTLINE_SCALAR leaves out the SIMD, for comparing with.
+
+#include "tree_sitter/alloc.h"
+#include "tree_sitter/array.h"
+
+#include "../bindings/c/tree_sitter/tree-sitter-orgmode.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)) && !defined(ORGMODE_OUTLINE_SCALAR)
+#define OUTLINE_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 is used if the CPU has it, whatever the compiler was told to target
+#if defined(OUTLINE_SSE2) && defined(__GNUC__)
+#define OUTLINE_AVX2
+#include <immintrin.h>
+#endif
+
+#define BLOCK_BYTES 64
+
+typedef struct {
+    uint64_t newlines;
+    uint64_t line_starts; // bytes which can start a line that matters
+} Masks;
+
+typedef enum {
+    CONTAINER_BLOCK,
+    CONTAINER_RAW_BLOCK, // a block whose body is one raw token
+    CONTAINER_DRAWER,
+    CONTAINER_PROPERTY_DRAWER,
+} ContainerKind;
+
+// a block or drawer that hasn't been closed yet
+typedef struct {
+    ContainerKind kind;
+    uint32_t entry;
+    const unsigned char *name; // blocks only
+    uint32_t name_length;
+} Container;
+
+typedef struct {
+    TSOrgmodeOutline *outline;
+    const unsigned char *text;
+    const unsigned char *end;
+    Array(Container) open;
+    bool out_of_memory; // the entries couldn't grow, so indexing stops
+} Indexer;
+
+// the blocks scan_raw_body reads the body of, rather than parsing it
+static const char *const raw_block_names[] = {
+    "src", "SRC", "example", "EXAMPLE", "export", "EXPORT", "comment", "COMMENT",
+};
+
+static inline unsigned count_trailing_zeros(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_ctzll(x);
+#else
+    unsigned n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+static inline unsigned count_ones(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_popcountll(x);
+#else
+    unsigned n = 0;
+    for (; x != 0; x &= x - 1) n++;
+    return n;
+#endif
+}
+
+static inline bool can_start_line(unsigned char c) {
+    return c == '*' || c == '#' || c == ':' || c == ' ' || c == '\t' || c >= 0x80;
+}
+
+#ifndef OUTLINE_SSE2
+static Masks masks_scalar(const unsigned char *p) {
+    Masks m = {0, 0};
+    for (unsigned i = 0; i < BLOCK_BYTES; i++) {
+        m.newlines |= (uint64_t) (p[i] == '\n') << i;
+        m.line_starts |= (uint64_t) can_start_line(p[i]) << i;
+    }
+    return m;
+}
+#endif
+
+#ifdef OUTLINE_SSE2
+static inline Masks masks_sse2(const unsigned char *p) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i hash = _mm_set1_epi8('#');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+
+    Masks m = {0, 0};
+    for (unsigned i = 0; i < BLOCK_BYTES; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (p + i));
+        __m128i starts = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, star), _mm_cmpeq_epi8(v, hash)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, colon),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab))));
+
+        // the sign bit is set for bytes past ASCII, which movemask picks out
+        m.newlines |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)) << i;
+        m.line_starts |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_or_si128(starts, v)) << i;
+    }
+    return m;
+}
+#endif
+
+#ifdef OUTLINE_AVX2
+__attribute__((target("avx2")))
+static inline Masks masks_avx2(const unsigned char *p) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i star = _mm256_set1_epi8('*');
+    const __m256i hash = _mm256_set1_epi8('#');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+
+    Masks m = {0, 0};
+    for (unsigned i = 0; i < BLOCK_BYTES; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (p + i));
+        __m256i starts = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, star), _mm256_cmpeq_epi8(v, hash)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, colon),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab))));
+
+        m.newlines |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)) << i;
+        m.line_starts |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(starts, v)) << i;
+    }
+    return m;
+}
+#endif
+
+// the length of the whitespace character at p, or 0. past ASCII, these are
+// the White_Space characters the scanner's classes know of, in UTF-8.
+static unsigned whitespace_length(const unsigned char *p, const unsigned char *end, bool blank_only) {
+    if (*p < 0x80) {
+        if (*p == ' ' || *p == '\t') return 1;
+        return !blank_only && *p >= '\t' && *p <= '\r';
+    }
+
+    size_t left = end - p;
+    if (left >= 2 && p[0] == 0xc2) {
+        if (p[1] == 0xa0) return 2; // no-break space
+        return !blank_only && p[1] == 0x85 ? 2 : 0;
+    }
+    if (left < 3) return 0;
+    if (p[0] == 0xe1 && p[1] == 0x9a && p[2] == 0x80) return 3; // ogham space mark
+    if (p[0] == 0xe3 && p[1] == 0x80 && p[2] == 0x80) return 3; // ideographic space
+    if (p[0] == 0xe2 && p[1] == 0x80) {
+        if (p[2] <= 0x8a || p[2] == 0xaf) return 3; // the U+2000 spaces, narrow no-break space
+        return !blank_only && (p[2] == 0xa8 || p[2] == 0xa9) ? 3 : 0; // line and paragraph separators
+    }
+    if (p[0] == 0xe2 && p[1] == 0x81 && p[2] == 0x9f) return 3; // medium mathematical space
+    return 0;
+}
+
+static inline const unsigned char *skip_blanks(const unsigned char *p, const unsigned char *end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+static const unsigned char *line_end(const unsigned char *p, const unsigned char *end) {
+    const unsigned char *newline = memchr(p, '\n', end - p);
+    return newline == NULL ? end : newline;
+}
+
+// matches an ASCII literal, ignoring the case of its letters if asked to
+static bool match(const unsigned char **p, const unsigned char *end, const char *literal, bool ignore_case) {
+    const unsigned char *q = *p;
+    for (; *literal != '\0'; literal++, q++) {
+        if (q == end) return false;
+        unsigned char c = *q, l = *literal;
+        if (ignore_case && c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        if (c != l) return false;
+    }
+    *p = q;
+    return true;
+}
+
+// the end of a block's name, which is everything up to the next whitespace
+static const unsigned char *scan_block_name(const unsigned char *p, const unsigned char *end) {
+    while (p < end && whitespace_length(p, end, false) == 0) p++;
+    return p;
+}
+
+// the end of a drawer or property's name. past ASCII, anything but
+// whitespace counts as a letter.
+static const unsigned char *scan_drawer_name(const unsigned char *p, const unsigned char *end, bool property) {
+    while (p < end) {
+        unsigned char c = *p;
+        if (c >= 0x80) {
+            if (whitespace_length(p, end, false) > 0) break;
+        } else if (!(
+            (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+            c == '_' || c == '-' || (property && c == '+')
+        )) {
+            break;
+        }
+        p++;
+    }
+    return p;
+}
+
+static uint32_t offset(const Indexer *x, const unsigned char *p) {
+    return (uint32_t) (p - x->text);
+}
+
+static TSOrgmodeOutlineEntry *add_entry(Indexer *x, TSOrgmodeOutlineKind kind, uint32_t level,
+                                        const unsigned char *start, uint32_t row) {
+    TSOrgmodeOutline *outline = x->outline;
+    if (outline->count == outline->capacity) {
+        uint32_t capacity = outline->capacity < 64 ? 64 : outline->capacity * 2;
+        TSOrgmodeOutlineEntry *entries = ts_realloc(outline->entries, capacity * sizeof(TSOrgmodeOutlineEntry));
+        if (entries == NULL) {
+            x->out_of_memory = true;
+            return NULL;
+        }
+        outline->entries = entries;
+        outline->capacity = capacity;
+    }
+
+    TSOrgmodeOutlineEntry *entry = &outline->entries[outline->count++];
+    *entry = (TSOrgmodeOutlineEntry) {
+        .kind = kind,
+        .level = level,
+        .start_byte = offset(x, start),
+        .start_row = row,
+    };
+    return entry;
+}
+
+static void open_container(Indexer *x, TSOrgmodeOutlineKind kind, ContainerKind container,
+                           const unsigned char *start, uint32_t row,
+                           const unsigned char *name, const unsigned char *name_end) {
+    if (add_entry(x, kind, x->open.size, start, row) == NULL) return;
+    array_push(&x->open, ((Container) {
+        .kind = container,
+        .entry = x->outline->count - 1,
+        .name = name,
+        .name_length = name == NULL ? 0 : (uint32_t) (name_end - name),
+    }));
+}
+
+static void close_container(Indexer *x, const unsigned char *end, uint32_t row, bool closed) {
+    Container container = array_pop(&x->open);
+    TSOrgmodeOutlineEntry *entry = &x->outline->entries[container.entry];
+    entry->end_byte = offset(x, end);
+    entry->end_row = row;
+    entry->closed = closed;
+}
+
+static inline Container *innermost(Indexer *x) {
+    return x->open.size == 0 ? NULL : array_back(&x->open);
+}
+
+// whether the innermost drawer is a property drawer, which has properties in
+// it rather than drawers, whatever blocks are inside it
+static bool in_property_drawer(const Indexer *x) {
+    for (uint32_t i = x->open.size; i > 0; i--) {
+        ContainerKind kind = x->open.contents[i - 1].kind;
+        if (kind == CONTAINER_PROPERTY_DRAWER) return true;
+        if (kind == CONTAINER_DRAWER) return false;
+    }
+    return false;
+}
+
+// whether the name at `p` is `name` but for the case of its letters, as
+// the scanner has it
+static bool block_name_at(const unsigned char *p, const unsigned char *end, const unsigned char *name, uint32_t length) {
+    if ((size_t) (end - p) < length) return false;
+    for (uint32_t i = 0; i < length; i++) {
+        unsigned char a = p[i], b = name[i];
+        if (a >= 'A' && a <= 'Z') a += 'a' - 'A';
+        if (b >= 'A' && b <= 'Z') b += 'a' - 'A';
+        if (a != b) return false;
+    }
+    return true;
+}
+
+static bool is_raw_block_name(const unsigned char *name, const unsigned char *name_end) {
+    size_t length = name_end - name;
+    for (size_t i = 0; i < sizeof(raw_block_names) / sizeof(raw_block_names[0]); i++) {
+        if (strlen(raw_block_names[i]) == length && memcmp(raw_block_names[i], name, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// the line after "#+", in a body that's parsed
+static void index_block_line(Indexer *x, const unsigned char *start, const unsigned char *p, uint32_t row) {
+    const unsigned char *end = x->end;
+
+    if (match(&p, end, "end_", true)) {
+        const unsigned char *name_end = scan_block_name(p, end);
+        Container *top = innermost(x);
+        if (top != NULL && top->kind == CONTAINER_BLOCK && top->name_length == (uint32_t) (name_end - p) &&
+            block_name_at(p, end, top->name, top->name_length)) {
+            close_container(x, name_end, row, true);
+        }
+        return;
+    }
+
+    if (!match(&p, end, "begin_", true)) return;
+
+    const unsigned char *name = p;
+    const unsigned char *name_end = scan_block_name(name, end);
+    if (name_end == name) return;
+
+    ContainerKind kind = is_raw_block_name(name, name_end) ? CONTAINER_RAW_BLOCK : CONTAINER_BLOCK;
+    open_container(x, TS_ORGMODE_OUTLINE_BLOCK, kind, start, row, name, name_end);
+}
+
+// the line after ':', in a body that's parsed
+static void index_drawer_line(Indexer *x, const unsigned char *start, const unsigned char *p, uint32_t row) {
+    const unsigned char *end = x->end;
+    bool property = in_property_drawer(x);
+
+    const unsigned char *name = p;
+    const unsigned char *name_end = scan_drawer_name(name, end, property);
+    if (name_end == name || name_end == end || *name_end != ':') return;
+    p = name_end + 1;
+
+    if (name_end - name == 3 && memcmp(name, "end", 3) == 0) {
+        Container *top = innermost(x);
+        if (top != NULL && (top->kind == CONTAINER_DRAWER || top->kind == CONTAINER_PROPERTY_DRAWER)) {
+            close_container(x, p, row, true);
+        }
+        return;
+    }
+
+    if (property) return;
+
+    // the grammar has a drawer's name on a line of its own
+    p = skip_blanks(p, end);
+    if (p < end && *p == '\r') p++;
+    if (p == end || *p != '\n') return;
+
+    bool properties = name_end - name == 10 && memcmp(name, "properties", 10) == 0;
+    open_container(x,
+                   properties ? TS_ORGMODE_OUTLINE_PROPERTY_DRAWER : TS_ORGMODE_OUTLINE_DRAWER,
+                   properties ? CONTAINER_PROPERTY_DRAWER : CONTAINER_DRAWER,
+                   start, row, NULL, NULL);
+}
+
+static void index_line(Indexer *x, const unsigned char *start, uint32_t row) {
+    if (x->out_of_memory) return;
+
+    const unsigned char *end = x->end;
+    Container *top = innermost(x);
+    bool raw = top != NULL && top->kind == CONTAINER_RAW_BLOCK;
+
+    // a heading ends everything still open. a raw body only stops for stars
+    // with a space after them, and a line starting with stars can't be
+    // anything but a heading.
+    if (*start == '*') {
+        const unsigned char *p = start;
+        while (p < end && *p == '*') p++;
+        if (p == end || !(*p == ' ' || (*p == '\t' && !raw))) return;
+
+        while (x->open.size > 0) close_container(x, start, row, false);
+
+        TSOrgmodeOutlineEntry *heading = add_entry(x, TS_ORGMODE_OUTLINE_HEADING, (uint32_t) (p - start), start, row);
+        if (heading == NULL) return;
+        heading->end_byte = offset(x, line_end(p, end));
+        heading->end_row = row;
+        heading->closed = true;
+        return;
+    }
+
+    if (raw) {
+        // scan_raw_body skips any blanks, not only the ones the grammar does
+        const unsigned char *p = start;
+        unsigned blank;
+        while (p < end && (blank = whitespace_length(p, end, true)) > 0) p += blank;
+
+        if (!match(&p, end, "#+end_", true) || !block_name_at(p, end, top->name, top->name_length)) {
+            return;
+        }
+        p += top->name_length;
+        if (p == end || whitespace_length(p, end, false) > 0) close_container(x, p, row, true);
+        return;
+    }
+
+    const unsigned char *p = skip_blanks(start, end);
+    if (p == end) return;
+
+    if (*p == '#') {
+        const unsigned char *hash = p;
+        if (match(&p, end, "#+", false)) index_block_line(x, hash, p, row);
+    } else if (*p == ':') {
+        index_drawer_line(x, p, p + 1, row);
+    }
+}
+
+// hands every line in the block that might matter to index_line. `carry` is
+// set if the last block ended with a newline, and so this one starts a line.
+static inline void index_block(Indexer *x, size_t block, Masks m, uint64_t *carry, uint32_t *row) {
+    uint64_t starts = ((m.newlines << 1) | *carry) & m.line_starts;
+    *carry = m.newlines >> (BLOCK_BYTES - 1);
+
+    while (starts != 0) {
+        unsigned bit = count_trailing_zeros(starts);
+        uint64_t before = m.newlines & ((UINT64_C(1) << bit) - 1);
+        index_line(x, x->text + block + bit, *row + count_ones(before));
+        starts &= starts - 1;
+    }
+    *row += count_ones(m.newlines);
+}
+
+// the last, partial block is zero padded, and a zero can't start a line that
+// matters or end one
+#define INDEX(x, masks) do { \
+    size_t length = (x)->end - (x)->text; \
+    uint64_t carry = 1; \
+    uint32_t row = 0; \
+    size_t block = 0; \
+    for (; block + BLOCK_BYTES <= length; block += BLOCK_BYTES) { \
+        index_block((x), block, masks((x)->text + block), &carry, &row); \
+    } \
+    if (block < length) { \
+        unsigned char tail[BLOCK_BYTES] = {0}; \
+        memcpy(tail, (x)->text + block, length - block); \
+        index_block((x), block, masks(tail), &carry, &row); \
+    } \
+    while ((x)->open.size > 0) close_container((x), (x)->end, row, false); \
+} while (0)
+
+#ifdef OUTLINE_SSE2
+static void index_sse2(Indexer *x) {
+    INDEX(x, masks_sse2);
+}
+#endif
+
+#ifdef OUTLINE_AVX2
+__attribute__((target("avx2")))
+static void index_avx2(Indexer *x) {
+    INDEX(x, masks_avx2);
+}
+#endif
+
+bool tree_sitter_orgmode_outline(TSOrgmodeOutline *outline, const char *text, size_t length) {
+    outline->count = 0;
+    if (length > UINT32_MAX) return false;
+
+    Indexer x = {
+        .outline = outline,
+        .text = (const unsigned char*) text,
+        .end = (const unsigned char*) text + length,
+        .open = array_new(),
+    };
+
+#if defined(OUTLINE_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        index_avx2(&x);
+    } else {
+        index_sse2(&x);
+    }
+#elif defined(OUTLINE_SSE2)
+    index_sse2(&x);
+#else
+    INDEX(&x, masks_scalar);
+#endif
+
+    array_delete(&x.open);
+    if (x.out_of_memory) {
+        outline->count = 0;
+        return false;
+    }
+    return true;
+}
+
+#undef INDEX
+
+void tree_sitter_orgmode_outline_delete(TSOrgmodeOutline *outline) {
+    ts_free(outline->entries);
+    outline->entries = NULL;
+    outline->count = 0;
+    outline->capacity = 0;
+}
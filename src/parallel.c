@@ -0,0 +1,161 @@
+// Splitting a document into chunks that parse independently, and running
+// work over them on several threads.
+//
+// A level 1 heading closes every section before it, so once every block and
+// drawer before it has been closed too, a parser starting there from nothing
+// is in the state a full parse would be. The chunks start at such headings,
+// and each holds whole top level sections. One left open stays on the
+// scanner's stacks, so nothing after it is split off.
+//
+// Parsing itself needs the tree-sitter runtime, which the library doesn't
+// link against, so it's in tree-sitter-orgmode-runtime.h:
+// tree_sitter_orgmode_parse_parallel.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../bindings/c/tree_sitter/tree-sitter-orgmode.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+uint32_t tree_sitter_orgmode_split(
+    const TSOrgmodeOutline *outline,
+    size_t length,
+    uint32_t max_chunks,
+    TSOrgmodeLineRange *chunks,
+    uint32_t capacity
+) {
+    if (max_chunks == 0) max_chunks = 1;
+
+    // a chunk is ended at the first level 1 heading past its share of the
+    // text, so chunks are never much smaller than the share
+    size_t share = length / max_chunks;
+    uint32_t count = 0;
+    TSOrgmodeLineRange chunk = {0, 0, UINT32_MAX, UINT32_MAX};
+
+    for (uint32_t i = 0; i < outline->count; i++) {
+        const TSOrgmodeOutlineEntry *entry = &outline->entries[i];
+        if (entry->kind != TS_ORGMODE_OUTLINE_HEADING) {
+            if (!entry->closed) break;
+            continue;
+        }
+        if (entry->level != 1) continue;
+        if (entry->start_byte == chunk.start_byte || entry->start_byte - chunk.start_byte < share) continue;
+        if (count + 1 == max_chunks) break;
+
+        chunk.end_byte = entry->start_byte;
+        chunk.end_row = entry->start_row;
+        if (count < capacity) chunks[count] = chunk;
+        count++;
+
+        chunk.start_byte = entry->start_byte;
+        chunk.start_row = entry->start_row;
+        chunk.end_byte = UINT32_MAX;
+        chunk.end_row = UINT32_MAX;
+    }
+
+    if (count < capacity) chunks[count] = chunk;
+    return count + 1;
+}
+
+unsigned tree_sitter_orgmode_cpu_count(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0) return (unsigned) cpus;
+#endif
+    return 1;
+}
+
+#ifndef _WIN32
+
+typedef struct {
+    TSOrgmodeParallelTask task;
+    void *context;
+    uint32_t count;
+    atomic_uint_least32_t next;
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    unsigned worker;
+} Worker;
+
+// items are handed out one at a time, so a worker that gets small ones just
+// takes more of them
+static void run_worker(Pool *pool, unsigned worker) {
+    for (;;) {
+        uint32_t item = atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed);
+        if (item >= pool->count) return;
+        pool->task(pool->context, worker, item);
+    }
+}
+
+static void *worker_main(void *payload) {
+    Worker *w = payload;
+    run_worker(w->pool, w->worker);
+    return NULL;
+}
+
+bool tree_sitter_orgmode_run_parallel(
+    unsigned threads,
+    uint32_t count,
+    TSOrgmodeParallelTask task,
+    void *context
+) {
+    if (threads > count) threads = count;
+    if (threads == 0) threads = 1;
+
+    Pool pool = {.task = task, .context = context, .count = count};
+    atomic_init(&pool.next, 0);
+
+    // the calling thread is worker 0
+    pthread_t *ids = NULL;
+    Worker *workers = NULL;
+    if (threads > 1) {
+        ids = malloc((threads - 1) * sizeof(pthread_t));
+        workers = malloc((threads - 1) * sizeof(Worker));
+        if (ids == NULL || workers == NULL) {
+            free(ids);
+            free(workers);
+            return false;
+        }
+    }
+
+    // if a thread can't be started, the ones that did and this one do its
+    // share between them
+    unsigned started = 0;
+    for (; started + 1 < threads; started++) {
+        workers[started] = (Worker) {&pool, started + 1};
+        if (pthread_create(&ids[started], NULL, worker_main, &workers[started]) != 0) break;
+    }
+
+    run_worker(&pool, 0);
+    for (unsigned i = 0; i < started; i++) pthread_join(ids[i], NULL);
+
+    free(ids);
+    free(workers);
+    return true;
+}
+
+#else
+
+// no threads here, so it's all done by the calling thread
+bool tree_sitter_orgmode_run_parallel(
+    unsigned threads,
+    uint32_t count,
+    TSOrgmodeParallelTask task,
+    void *context
+) {
+    (void) threads;
+    for (uint32_t i = 0; i < count; i++) task(context, 0, i);
+    return true;
+}
+
+#endif
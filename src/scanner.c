@@ -3,8 +3,20 @@
 #include "tree_sitter/array.h"
 
 #include <stdbool.h>
-#include <wctype.h>
 
+// the counters are laid out by the public header, which packaged copies of
+// the scanner don't ship with. none of them are built with statistics, but
+// where it's there the token count in it is checked against the enum below.
+#ifdef ORGMODE_SCANNER_STATS
+#include "../bindings/c/tree_sitter/tree-sitter-orgmode.h"
+#include <stdlib.h>
+#elif defined(__has_include)
+#if __has_include("../bindings/c/tree_sitter/tree-sitter-orgmode.h")
+#include "../bindings/c/tree_sitter/tree-sitter-orgmode.h"
+#endif
+#endif
+
+// names up to this long are scanned without touching the allocator
 #define NAME_MAX_LEN 64
 
 // #define DEBUG
@@ -21,12 +33,18 @@
     #define LOG(fmt, ...)
 #endif
 
+#ifdef ORGMODE_SCANNER_STATS
+    #define STAT(...) do { __VA_ARGS__; } while (0)
+#else
+    #define STAT(...)
+#endif
+
 #define ARRAYS \
     ARRAY(section_level, unsigned char) \
     ARRAY(list_indents, unsigned char) \
     ARRAY(drawer_stack, DrawerType) \
     ARRAY(markup_stack, enum TokenType) \
-    ARRAY_STR(block_name_stack)
+    ARRAY_NAME(block_name_stack)
 
 #define TOKEN_TYPES \
     TOK(BLOCK_BEGIN_MARKER) \
@@ -61,8 +79,28 @@
     TOK(PATHREG) \
     TOK(COMMENT_LINE) \
     TOK(NEWLINE) \
+    TOK(RAW_BODY) \
     TOK(ERROR_SENTINEL)
 
+// block names which get a fixed id. any other name is interned into a table
+// kept by the scanner. names are matched case sensitively, so the common
+// upper case spellings get their own ids too.
+#define BLOCK_NAMES \
+    BLOCK(SRC, "src") \
+    BLOCK(SRC_UC, "SRC") \
+    BLOCK(EXAMPLE, "example") \
+    BLOCK(EXAMPLE_UC, "EXAMPLE") \
+    BLOCK(QUOTE, "quote") \
+    BLOCK(QUOTE_UC, "QUOTE") \
+    BLOCK(VERSE, "verse") \
+    BLOCK(VERSE_UC, "VERSE") \
+    BLOCK(CENTER, "center") \
+    BLOCK(CENTER_UC, "CENTER") \
+    BLOCK(COMMENT, "comment") \
+    BLOCK(COMMENT_UC, "COMMENT") \
+    BLOCK(EXPORT, "export") \
+    BLOCK(EXPORT_UC, "EXPORT")
+
 #define NUM_MARKUP_TOKS (sizeof(markup_begins) / sizeof(enum TokenType))
 #define NUM_TOKS ERROR_SENTINEL
 
@@ -72,12 +110,130 @@ TOKEN_TYPES
 #undef TOK
 };
 
+static const char *const token_names[] = {
+#define TOK(id) #id,
+TOKEN_TYPES
+#undef TOK
+};
+
+const char *tree_sitter_orgmode_external_token_name(unsigned token) {
+    return token <= ERROR_SENTINEL ? token_names[token] : NULL;
+}
+
+#ifdef TREE_SITTER_ORGMODE_H_
+_Static_assert(ERROR_SENTINEL + 1 == TREE_SITTER_ORGMODE_EXTERNAL_TOKEN_COUNT,
+               "the public header has the wrong number of external tokens");
+#endif
+
+#ifdef ORGMODE_SCANNER_STATS
+
+_Static_assert(ERROR_SENTINEL < 64, "valid token sets must fit in 64 bits");
+
+// the valid sets are kept in an open-addressed table twice the size of the
+// most there can be, so a probe always ends at an empty slot
+#define VALID_SET_SLOTS (2 * TREE_SITTER_ORGMODE_MAX_VALID_SETS)
+
+static TSOrgmodeScannerStats stats;
+static TSOrgmodeValidSetCount valid_set_table[VALID_SET_SLOTS];
+
+// bytes advanced in the current scan, and how many of them were before the
+// last mark_end
+static uint64_t scan_advanced, scan_marked;
+
+static void stats_begin_scan(const bool *valid_symbols) {
+    stats.scans++;
+    scan_advanced = 0;
+    scan_marked = 0;
+
+    uint64_t set = 0;
+    for (unsigned i = 0; i <= ERROR_SENTINEL; i++) {
+        if (valid_symbols[i]) set |= (uint64_t) 1 << i;
+    }
+
+    unsigned slot = (unsigned) ((set * 0x9e3779b97f4a7c15) >> 40) % VALID_SET_SLOTS;
+    for (;; slot = (slot + 1) % VALID_SET_SLOTS) {
+        TSOrgmodeValidSetCount *entry = &valid_set_table[slot];
+        if (entry->scans > 0 && entry->valid_tokens == set) {
+            entry->scans++;
+            return;
+        }
+        if (entry->scans == 0) {
+            if (stats.valid_set_count == TREE_SITTER_ORGMODE_MAX_VALID_SETS) break;
+            stats.valid_set_count++;
+            entry->valid_tokens = set;
+            entry->scans = 1;
+            return;
+        }
+    }
+
+    stats.other_valid_set_scans++;
+}
+
+static void stats_end_scan(const TSLexer *lexer, bool found) {
+    stats.bytes_advanced += scan_advanced;
+    if (found) {
+        stats.tokens[lexer->result_symbol]++;
+        stats.bytes_discarded += scan_advanced - scan_marked;
+    } else {
+        stats.bytes_discarded += scan_advanced;
+    }
+}
+
+static int compare_valid_sets(const void *a, const void *b) {
+    uint64_t x = ((const TSOrgmodeValidSetCount*) a)->scans;
+    uint64_t y = ((const TSOrgmodeValidSetCount*) b)->scans;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+bool tree_sitter_orgmode_scanner_stats(TSOrgmodeScannerStats *out) {
+    *out = stats;
+
+    unsigned n = 0;
+    for (unsigned i = 0; i < VALID_SET_SLOTS; i++) {
+        if (valid_set_table[i].scans > 0) out->valid_sets[n++] = valid_set_table[i];
+    }
+    qsort(out->valid_sets, n, sizeof(out->valid_sets[0]), compare_valid_sets);
+
+    return true;
+}
+
+void tree_sitter_orgmode_scanner_stats_reset(void) {
+    memset(&stats, 0, sizeof(stats));
+    memset(valid_set_table, 0, sizeof(valid_set_table));
+}
+
+#else
+
+struct TSOrgmodeScannerStats;
+
+bool tree_sitter_orgmode_scanner_stats(struct TSOrgmodeScannerStats *out) {
+    (void) out;
+    return false;
+}
+
+void tree_sitter_orgmode_scanner_stats_reset(void) {}
+
+#endif
+
 typedef enum {
     NORMAL_DRAWER = 'N',
     PROPERTY_DRAWER = 'P',
     NO_DRAWER = 'X',
 } DrawerType;
 
+typedef uint16_t BlockName;
+
+enum {
+    // not a valid id. in serialized state, it marks a name which is written
+    // out in full.
+    NO_BLOCK_NAME,
+#define BLOCK(id, _) BLOCK_##id,
+    BLOCK_NAMES
+#undef BLOCK
+    // ids from here on index into the scanner's table of custom names
+    FIRST_CUSTOM_BLOCK_NAME,
+};
+
 typedef enum {
     HYPHEN = '-',
     STAR = '*',
@@ -124,147 +280,395 @@ static const char markup_chars[NUM_TOKS] = {
     [LINK_END] = ']',
 };
 
-static const bool markup_no_follow[NUM_TOKS][255] = {
-#define NO(c) [c] = true
-#define WHITESPACE ['\t'] = true, [' '] = true
-
-    // the regular 'markup' tokens can't be followed by themselves or any
-    // whitespace
-    [BOLD_START] = {NO('*'), WHITESPACE},
-    [ITALIC_START] = {NO('/'), WHITESPACE},
-    [UNDERLINE_START] = {NO('_'), WHITESPACE},
-    [VERBATIM_START] = {NO('='), WHITESPACE},
-    [CODE_INLINE_START] = {NO('~'), WHITESPACE},
-    [STRIKETHROUGH_START] = {NO('+'), WHITESPACE},
-
-    // [ and ] for links can be followed by any character.
-    [LINK_START] = {},
-    [LINK_END] = {},
+static const unsigned char markup_index[NUM_TOKS] = {
+    [BOLD_START] = 0,
+    [ITALIC_START] = 1,
+    [UNDERLINE_START] = 2,
+    [VERBATIM_START] = 3,
+    [CODE_INLINE_START] = 4,
+    [STRIKETHROUGH_START] = 5,
+    [LINK_START] = 6,
+};
 
-    // TODO: _END tokens should ONLY be followed by:
-    // "Either a whitespace character, -, ., ,, ;, :, !, ?, ', ), }, [, ", \ (backslash), or the end of a line."
+// for each character, a bit (by markup_index) for the kind of markup it
+// closes
+static const unsigned char markup_closed_by[128] = {
+    ['*'] = 1 << 0,
+    ['/'] = 1 << 1,
+    ['_'] = 1 << 2,
+    ['='] = 1 << 3,
+    ['~'] = 1 << 4,
+    ['+'] = 1 << 5,
+    [']'] = 1 << 6,
+};
 
-    // TODO: we also need to do the characters which the tokens can come *after*!
-    // i.e. "Either a whitespace character, -, (, {, ', ", or the beginning of a line."
+// every per-character test the scanner makes is a lookup of one of these
+// classes. ASCII characters come from char_classes; anything else takes the
+// slower path through unicode_char_class.
+typedef enum {
+    CC_WHITESPACE = 1 << 0,
+    CC_NOT_WHITESPACE = 1 << 1,
+    CC_BLANK = 1 << 2, // horizontal whitespace
+    CC_DIGIT = 1 << 3,
+    CC_UPPER = 1 << 4,
+    CC_NAME = 1 << 5, // drawer names
+    CC_PROPERTY_NAME = 1 << 6,
+    CC_KW = 1 << 7,
+    CC_WORD = 1 << 8,
+    CC_PATHREG = 1 << 9,
+    CC_COMMENT = 1 << 10,
+    CC_MARKUP = 1 << 11, // delimits markup or links
+} CharClass;
+
+#define IS_SPACE(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+#define IS_UPPER(c) ((c) >= 'A' && (c) <= 'Z')
+#define IS_ALNUM(c) (IS_DIGIT(c) || IS_UPPER(c) || ((c) >= 'a' && (c) <= 'z'))
+#define IS_MARKUP(c) ( \
+    (c) == '*' || (c) == '/' || (c) == '_' || (c) == '=' || \
+    (c) == '~' || (c) == '+' || (c) == '[' || (c) == ']')
+
+#define CLASSES_OF(c) ( \
+    (IS_SPACE(c) ? CC_WHITESPACE : CC_NOT_WHITESPACE) | \
+    ((c) == ' ' || (c) == '\t' ? CC_BLANK : 0) | \
+    (IS_DIGIT(c) ? CC_DIGIT : 0) | \
+    (IS_UPPER(c) ? CC_UPPER : 0) | \
+    (IS_ALNUM(c) || (c) == '_' || (c) == '-' ? CC_NAME | CC_PROPERTY_NAME : 0) | \
+    ((c) == '+' ? CC_PROPERTY_NAME : 0) | \
+    (!IS_SPACE(c) && (c) != ':' ? CC_KW : 0) | \
+    (!IS_SPACE(c) && (c) != '\0' ? CC_WORD : 0) | \
+    ((c) != '[' && (c) != ']' && (c) != '\n' && (c) != '\r' ? CC_PATHREG : 0) | \
+    ((c) != '\n' ? CC_COMMENT : 0) | \
+    (IS_MARKUP(c) ? CC_MARKUP : 0))
+
+#define CLASSES_1(c) CLASSES_OF(c),
+#define CLASSES_4(c) CLASSES_1(c) CLASSES_1(c + 1) CLASSES_1(c + 2) CLASSES_1(c + 3)
+#define CLASSES_16(c) CLASSES_4(c) CLASSES_4(c + 4) CLASSES_4(c + 8) CLASSES_4(c + 12)
+#define CLASSES_64(c) CLASSES_16(c) CLASSES_16(c + 16) CLASSES_16(c + 32) CLASSES_16(c + 48)
+
+static const uint16_t char_classes[128] = {
+    CLASSES_64(0)
+    CLASSES_64(64)
+};
 
-#undef NO
-#undef WHITESPACE
+#undef CLASSES_64
+#undef CLASSES_16
+#undef CLASSES_4
+#undef CLASSES_1
+#undef CLASSES_OF
+#undef IS_MARKUP
+#undef IS_ALNUM
+#undef IS_UPPER
+#undef IS_DIGIT
+#undef IS_SPACE
+
+static const char *const block_names[FIRST_CUSTOM_BLOCK_NAME] = {
+#define BLOCK(id, name) [BLOCK_##id] = name,
+    BLOCK_NAMES
+#undef BLOCK
 };
 
-#define ARRAY_STR(name) ARRAY(name, const char *)
+// a stack of interned block names
+#define ARRAY_NAME(name) ARRAY(name, BlockName)
 
 typedef struct {
     #define ARRAY(name, type) Array(type) name;
     ARRAYS
     #undef ARRAY
+
+    // scratch space for the name currently being scanned. it keeps its
+    // capacity between scans, so it only grows for unusually long names.
+    Array(char) scratch;
+
+    // interned block names which aren't in `block_names`, stored back to
+    // back with NUL terminators. the name with id FIRST_CUSTOM_BLOCK_NAME + i
+    // starts at custom_block_names[custom_block_name_offsets[i]].
+    Array(char) custom_block_names;
+    Array(uint32_t) custom_block_name_offsets;
+
+    // how many of each kind of markup are on markup_stack, by markup_index,
+    // and a bit for each kind with any at all. these aren't serialized; they
+    // follow from the stack.
+    uint16_t open_markup_counts[NUM_MARKUP_TOKS];
+    unsigned char open_markup;
+
+    // the column the current scan started at, or UNKNOWN_COLUMN until it's
+    // needed, and how many characters the scan has advanced past since.
+    // nothing needs a column once a scan has gone past a newline, so that's
+    // all it takes to know the column anywhere in the scan.
+    uint32_t start_column;
+    uint32_t advanced;
 } Scanner;
 
-static inline bool char_eq(char a, char b, bool ignore_case) {
+#define UNKNOWN_COLUMN UINT32_MAX
+
+// lookahead is a codepoint, not a byte, so anything past ASCII is classified
+// here. this doesn't depend on the locale, unlike wctype. whitespace is
+// Unicode's White_Space property, and everything else counts as a letter,
+// like Emacs' \w does for the names in drawers and properties.
+static uint16_t unicode_char_class(int32_t c) {
+    switch (c) {
+        case 0x0085: case 0x2028: case 0x2029:
+            return CC_WHITESPACE | CC_PATHREG | CC_COMMENT;
+        case 0x00a0: case 0x1680: case 0x202f: case 0x205f: case 0x3000:
+            return CC_WHITESPACE | CC_BLANK | CC_PATHREG | CC_COMMENT;
+        default:
+            if (c >= 0x2000 && c <= 0x200a) {
+                return CC_WHITESPACE | CC_BLANK | CC_PATHREG | CC_COMMENT;
+            }
+
+            // this includes anything the lexer couldn't decode
+            return CC_NOT_WHITESPACE | CC_NAME | CC_PROPERTY_NAME | CC_KW |
+                CC_WORD | CC_PATHREG | CC_COMMENT;
+    }
+}
+
+static inline bool has_class(int32_t c, CharClass classes) {
+    if ((uint32_t) c < 128) return char_classes[c] & classes;
+    return unicode_char_class(c) & classes;
+}
+
+static inline int32_t fold_case(int32_t c) {
+    return has_class(c, CC_UPPER) ? c + ('a' - 'A') : c;
+}
+
+static inline bool char_eq(int32_t a, char b, bool ignore_case) {
     if (ignore_case) {
-        return towlower(a) == towlower(b);
+        return fold_case(a) == fold_case(b);
     } else {
         return a == b;
     }
 }
 
-static unsigned scan_literal(TSLexer *lexer, const char *string, bool ignore_case) {
+// the scanner advances and marks the end only through these, so that the
+// statistics can see how far it went
+static inline void advance(Scanner *s, TSLexer *lexer, bool skip) {
+    STAT(
+        int32_t c = lexer->lookahead;
+        scan_advanced += c == '\0' && lexer->eof(lexer) ? 0
+            : (uint32_t) c < 0x80 ? 1 : (uint32_t) c < 0x800 ? 2 : (uint32_t) c < 0x10000 ? 3 : 4
+    );
+    s->advanced++;
+    lexer->advance(lexer, skip);
+}
+
+static inline void mark_end(TSLexer *lexer) {
+    STAT(scan_marked = scan_advanced);
+    lexer->mark_end(lexer);
+}
+
+// the column `offset` characters past the start of the scan. the lexer is
+// asked at most once a scan, because it answers by walking back to the start
+// of the line, and because a token that needed it can't be reused by a later
+// parse once anything before it on its line changes.
+static unsigned column_at(Scanner *s, TSLexer *lexer, uint32_t offset) {
+    if (s->start_column == UNKNOWN_COLUMN) {
+        s->start_column = lexer->get_column(lexer) - s->advanced;
+    }
+    return s->start_column + offset;
+}
+
+// the lookahead's column
+static inline unsigned column(Scanner *s, TSLexer *lexer) {
+    return column_at(s, lexer, s->advanced);
+}
+
+static unsigned scan_literal(Scanner *s, TSLexer *lexer, const char *string, bool ignore_case) {
     unsigned len = 0;
 
     for (char c = *string; c != '\0'; c = *(++string)) {
         if (lexer->eof(lexer) || !char_eq(lexer->lookahead, c, ignore_case)) {
             return len;
         }
-        lexer->advance(lexer, false);
+        advance(s, lexer, false);
         len++;
     }
     return len;
 }
 
-static const char *scan_while(TSLexer *lexer, bool (*pred)(char)) {
-    if (lexer->eof(lexer) || !pred(lexer->lookahead)) return NULL;
+// appends a codepoint to the scratch buffer, encoded as UTF-8
+static void scratch_push(Scanner *s, int32_t c) {
+    if ((uint32_t) c < 0x80) {
+        array_push(&s->scratch, c);
+        return;
+    }
 
-    char *name = ts_malloc(sizeof(char) * NAME_MAX_LEN);
+    char bytes[4];
     unsigned n;
+    if (c < 0x800) {
+        bytes[0] = 0xc0 | (c >> 6);
+        n = 2;
+    } else if (c < 0x10000) {
+        bytes[0] = 0xe0 | (c >> 12);
+        n = 3;
+    } else {
+        bytes[0] = 0xf0 | (c >> 18);
+        n = 4;
+    }
+    for (unsigned i = 1; i < n; i++) {
+        bytes[i] = 0x80 | ((c >> (6 * (n - 1 - i))) & 0x3f);
+    }
+    array_extend(&s->scratch, n, bytes);
+}
 
-    for (n = 0; pred(lexer->lookahead) && !lexer->eof(lexer); n++) {
-        name[n] = lexer->lookahead;
-        lexer->advance(lexer, false);
+// scans a name made of characters in `classes` into the scanner's scratch
+// buffer, and NUL-terminates it. returns the length of the name in bytes,
+// which is 0 if there wasn't one.
+static unsigned scan_name(Scanner *s, TSLexer *lexer, CharClass classes) {
+    array_clear(&s->scratch);
+
+    while (!lexer->eof(lexer) && has_class(lexer->lookahead, classes)) {
+        scratch_push(s, lexer->lookahead);
+        advance(s, lexer, false);
     }
 
-    name[n] = '\0';
-    return name;
+    unsigned len = s->scratch.size;
+    array_push(&s->scratch, '\0');
+    return len;
 }
 
-static unsigned skip_while(TSLexer *lexer, bool (*pred)(char), bool ws) {
-    if (!pred(lexer->lookahead)) return 0;
+static const char *block_name_str(const Scanner *s, BlockName id) {
+    if (id < FIRST_CUSTOM_BLOCK_NAME) return block_names[id];
 
-    unsigned n;
-    for (n = 0; pred(lexer->lookahead); n++) {
-        lexer->advance(lexer, ws);
+    uint32_t offset = s->custom_block_name_offsets.contents[id - FIRST_CUSTOM_BLOCK_NAME];
+    return s->custom_block_names.contents + offset;
+}
+
+// whether two block names are the same but for the case of their letters,
+// as "#+BEGIN_SRC" may be ended by "#+end_src"
+static bool block_names_match(const char *a, const char *b) {
+    for (; *a != '\0' && *b != '\0'; a++, b++) {
+        if (!char_eq(*a, *b, true)) return false;
     }
+    return *a == *b;
+}
 
-    return n;
+// looks up the id of a block name, returning NO_BLOCK_NAME if it hasn't
+// been interned.
+static BlockName find_block_name(const Scanner *s, const char *name) {
+    for (BlockName id = NO_BLOCK_NAME + 1; id < FIRST_CUSTOM_BLOCK_NAME; id++) {
+        if (strcmp(name, block_names[id]) == 0) return id;
+    }
+
+    for (uint32_t i = 0; i < s->custom_block_name_offsets.size; i++) {
+        const char *custom = s->custom_block_names.contents + s->custom_block_name_offsets.contents[i];
+        if (strcmp(name, custom) == 0) return FIRST_CUSTOM_BLOCK_NAME + i;
+    }
+
+    return NO_BLOCK_NAME;
 }
 
-static inline bool is_name_char(char c) {
-    return iswalnum(c) || c == '_' || c == '-';
+static BlockName intern_block_name(Scanner *s, const char *name, unsigned len) {
+    BlockName id = find_block_name(s, name);
+    if (id != NO_BLOCK_NAME) return id;
+
+    id = FIRST_CUSTOM_BLOCK_NAME + s->custom_block_name_offsets.size;
+    array_push(&s->custom_block_name_offsets, s->custom_block_names.size);
+    array_extend(&s->custom_block_names, len + 1, name);
+    return id;
 }
 
-static inline bool is_property_name_char(char c) {
-    return is_name_char(c) || c == '+';
+// blocks whose contents are verbatim, and so are scanned as one RAW_BODY
+static bool is_raw_block(BlockName id) {
+    switch (id) {
+        case BLOCK_SRC: case BLOCK_SRC_UC:
+        case BLOCK_EXAMPLE: case BLOCK_EXAMPLE_UC:
+        case BLOCK_EXPORT: case BLOCK_EXPORT_UC:
+        case BLOCK_COMMENT: case BLOCK_COMMENT_UC:
+            return true;
+        default:
+            return false;
+    }
 }
 
-static inline bool not_whitespace(char c) {
-    return !iswspace(c);
+static unsigned skip_while(Scanner *s, TSLexer *lexer, CharClass classes, bool ws) {
+    if (!has_class(lexer->lookahead, classes)) return 0;
+
+    unsigned n;
+    for (n = 0; has_class(lexer->lookahead, classes); n++) {
+        // some classes take in the '\0' we see at the end, so stop there
+        if (lexer->lookahead == '\0' && lexer->eof(lexer)) break;
+        advance(s, lexer, ws);
+    }
+
+    return n;
 }
 
-static inline bool is_whitespace(char c) {
-    return iswspace(c);
+static inline bool is_whitespace(int32_t c) {
+    return has_class(c, CC_WHITESPACE);
 }
 
-static inline bool is_kw_char(char c) {
-    return c != ':' && not_whitespace(c);
+static inline bool is_kw_char(int32_t c) {
+    return has_class(c, CC_KW);
 }
 
-static inline bool is_comment_char(char c) {
-    return c != '\n';
+static inline bool is_comment_char(int32_t c) {
+    return has_class(c, CC_COMMENT);
 }
 
-static inline bool is_pathreg_char(char c) {
-    return c != '[' && c != ']' && c != '\n' && c != '\r';
+static inline bool is_pathreg_char(int32_t c) {
+    return has_class(c, CC_PATHREG);
 }
 
-static inline bool is_checkbox_char(char c) {
+static inline bool is_checkbox_char(int32_t c) {
     return c == ' ' || c == 'X' || c == '-';
 }
 
-static bool is_word_char(Scanner *s, char c) {
-    if (c == '\0') return false;
+// whether `c` may directly follow the start of some markup
+static inline bool markup_can_follow(enum TokenType type, int32_t c) {
+    // [ and ] for links can be followed by any character.
+    if (type == LINK_START) return true;
 
-    // words can't contain any of the markup symbols (e.g. *, /) we're
-    // currently inside. otherwise, they would consume the end token.
-    for (int i = 0; i < s->markup_stack.size; i++) {
-        enum TokenType start_type = s->markup_stack.contents[i];
-        enum TokenType end_type = markup_ends[start_type];
-        if (c == markup_chars[end_type]) return false;
+    // TODO: _END tokens should ONLY be followed by:
+    // "Either a whitespace character, -, ., ,, ;, :, !, ?, ', ), }, [, ", \ (backslash), or the end of a line."
+
+    // TODO: we also need to do the characters which the tokens can come *after*!
+    // i.e. "Either a whitespace character, -, (, {, ', ", or the beginning of a line."
+
+    // the regular 'markup' tokens can't be followed by themselves or any
+    // whitespace
+    return c != markup_chars[type] && !has_class(c, CC_BLANK);
+}
+
+static void push_markup(Scanner *s, enum TokenType type) {
+    unsigned kind = markup_index[type];
+    array_push(&s->markup_stack, type);
+    s->open_markup_counts[kind]++;
+    s->open_markup |= 1 << kind;
+}
+
+static void pop_markup(Scanner *s) {
+    unsigned kind = markup_index[array_pop(&s->markup_stack)];
+    if (--s->open_markup_counts[kind] == 0) {
+        s->open_markup &= ~(1 << kind);
     }
+}
 
-    if (is_whitespace(c)) return false;
+static void clear_markup(Scanner *s) {
+    array_clear(&s->markup_stack);
+    memset(s->open_markup_counts, 0, sizeof(s->open_markup_counts));
+    s->open_markup = 0;
+}
 
-    return true;
+static inline bool is_word_char(const Scanner *s, int32_t c) {
+    if (!has_class(c, CC_WORD)) return false;
+
+    // words can't contain any of the markup symbols (e.g. *, /) we're
+    // currently inside. otherwise, they would consume the end token.
+    return (uint32_t) c >= 128 || !(markup_closed_by[c] & s->open_markup);
 }
 
-static Bullet scan_bullet(TSLexer *lexer) {
+static Bullet scan_bullet(Scanner *s, TSLexer *lexer) {
     Bullet kind = NO_BULLET;
 
     if (lexer->lookahead == '-') {
         kind = HYPHEN;
-    } else if (lexer->lookahead == '*' && lexer->get_column(lexer) > 0) {
+    } else if (lexer->lookahead == '*' && column(s, lexer) > 0) {
         kind = STAR;
     } else if (lexer->lookahead == '+') {
         kind = PLUS;
-    } else if (iswalnum(lexer->lookahead)) {
-        while (iswdigit(lexer->lookahead)) lexer->advance(lexer, false);
+    } else if (has_class(lexer->lookahead, CC_DIGIT)) {
+        while (has_class(lexer->lookahead, CC_DIGIT)) advance(s, lexer, false);
 
         if (lexer->lookahead == '.') {
             kind = COUNTER_DOT;
@@ -275,7 +679,7 @@ static Bullet scan_bullet(TSLexer *lexer) {
 
     if (kind == NO_BULLET) return NO_BULLET;
 
-    lexer->advance(lexer, false);
+    advance(s, lexer, false);
 
     if (is_whitespace(lexer->lookahead)) {
         return kind;
@@ -287,7 +691,7 @@ static Bullet scan_bullet(TSLexer *lexer) {
 static bool scan_stars(Scanner *s, TSLexer *lexer, const bool *valid_symbols, unsigned char found_already) {
     unsigned char new_level = found_already;
     while (lexer->lookahead == '*') {
-        lexer->advance(lexer, false);
+        advance(s, lexer, false);
         new_level++;
     }
 
@@ -298,7 +702,7 @@ static bool scan_stars(Scanner *s, TSLexer *lexer, const bool *valid_symbols, un
     } else {
         LOG("***> emitting STARS");
         lexer->result_symbol = STARS;
-        lexer->mark_end(lexer);
+        mark_end(lexer);
 
         if (!is_whitespace(lexer->lookahead)) {
             // must be followed up by whitespace.
@@ -319,11 +723,11 @@ static bool scan_markup_end(Scanner *s, TSLexer *lexer, const bool *valid_symbol
         enum TokenType type = markup_ends[markup_begins[i]];
         const char ch = markup_chars[type];
         if (valid_symbols[type] && lexer->lookahead == ch) {
-            lexer->advance(lexer, false);
+            advance(s, lexer, false);
             lexer->result_symbol = type;
-            lexer->mark_end(lexer);
+            mark_end(lexer);
             LOG("scanned '%c', markup end", ch);
-            array_pop(&s->markup_stack);
+            pop_markup(s);
             return true;
         }
     }
@@ -338,28 +742,28 @@ static bool scan_markup_start(Scanner *s, TSLexer *lexer, const bool *valid_symb
         enum TokenType type = markup_begins[i];
         const char ch = markup_chars[type];
         if (valid_symbols[type] && lexer->lookahead == ch) {
-            lexer->advance(lexer, false);
+            advance(s, lexer, false);
 
             if (valid_symbols[CHECKBOX] && type == LINK_START && is_checkbox_char(lexer->lookahead)) {
                 LOG("looks like we've got a checkbox here?");
-                lexer->advance(lexer, false);
+                advance(s, lexer, false);
                 if (lexer->lookahead == markup_chars[LINK_END]) {
-                    lexer->advance(lexer, false);
+                    advance(s, lexer, false);
                     lexer->result_symbol = CHECKBOX;
-                    lexer->mark_end(lexer);
+                    mark_end(lexer);
                     return true;
                 } else {
                     *fail = ch;
                 }
             }
 
-            if (markup_no_follow[type][lexer->lookahead]) {
+            if (!markup_can_follow(type, lexer->lookahead)) {
                 LOG("failed to scan '%c' markup start. lookahead '%c' cannot follow", ch, lexer->lookahead);
                 *fail = ch;
             } else {
                 lexer->result_symbol = type;
-                lexer->mark_end(lexer);
-                array_push(&s->markup_stack, type);
+                mark_end(lexer);
+                push_markup(s, type);
                 LOG("scanned '%c', markup start", ch);
                 return true;
             }
@@ -369,21 +773,101 @@ static bool scan_markup_start(Scanner *s, TSLexer *lexer, const bool *valid_symb
     return false;
 }
 
-bool tree_sitter_orgmode_external_scanner_scan(
-    void *payload,
-    TSLexer *lexer,
-    const bool *valid_symbols
-) {
-    Scanner *s = (Scanner*) payload;
+static bool scan_pathreg(Scanner *s, TSLexer *lexer) {
+    LOG("trying pathreg");
+
+    advance(s, lexer, false);
+
+    unsigned n;
+    for (n = 1;; n++) {
+        int32_t ch = lexer->lookahead;
+
+        // '\0' is a pathreg char, but it's also what we see at the end
+        if (!is_pathreg_char(ch) || (ch == '\0' && lexer->eof(lexer))) break;
+
+        advance(s, lexer, false);
+
+        if (ch == '\\' && (lexer->lookahead == '[' || lexer->lookahead == ']' || lexer->lookahead == '\\')) {
+            advance(s, lexer, false);
+        }
+    }
+
+    LOG("got pathreg, len: %d", n);
+    mark_end(lexer);
+    lexer->result_symbol = PATHREG;
+    return true;
+}
+
+// the body of a raw block, from the start of a line up to the #+end_ line
+// which matches the innermost block, or up to a heading, which ends the block
+// too. it's read a line at a time, and nothing inside is scanned for markup.
+//
+// the #+end_ marker is only recognised as the lookahead, so the body takes in
+// the end line's indentation. if the end comes before any line of the body,
+// the marker is returned instead.
+static bool scan_raw_body(Scanner *s, TSLexer *lexer, const bool *valid_symbols) {
+    const char *name = block_name_str(s, *array_back(&s->block_name_stack));
+    bool empty = true;
+
+    while (!lexer->eof(lexer)) {
+        if (lexer->lookahead == '*') {
+            while (lexer->lookahead == '*') advance(s, lexer, false);
+            if (lexer->lookahead == ' ') break;
+        } else {
+            while (has_class(lexer->lookahead, CC_BLANK)) advance(s, lexer, false);
+
+            if (lexer->lookahead == '#') {
+                if (!empty) mark_end(lexer);
+                advance(s, lexer, false);
+
+                if (scan_literal(s, lexer, "+end_", true) + 1 == sizeof("+end_")) {
+                    if (empty) mark_end(lexer);
+
+                    // org doesn't care about the case of either half
+                    if (scan_literal(s, lexer, name, true) == strlen(name) &&
+                        (lexer->eof(lexer) || !has_class(lexer->lookahead, CC_NOT_WHITESPACE))) {
+                        if (!empty) break;
+                        if (!valid_symbols[BLOCK_END_MARKER]) return false;
+
+                        lexer->result_symbol = BLOCK_END_MARKER;
+                        return true;
+                    }
+                }
+            }
+        }
+
+        while (lexer->lookahead != '\n') {
+            if (lexer->lookahead == '\0' && lexer->eof(lexer)) break;
+            advance(s, lexer, false);
+        }
+        if (lexer->lookahead == '\n') advance(s, lexer, false);
+
+        mark_end(lexer);
+        empty = false;
+    }
+
+    if (empty) return false;
+
+    LOG("got a raw body for '%s'", name);
+    clear_markup(s);
+    lexer->result_symbol = RAW_BODY;
+    return true;
+}
 
+static bool scan(Scanner *s, TSLexer *lexer, const bool *valid_symbols) {
     if (valid_symbols[ERROR_SENTINEL]) {
         LOG("!!! error");
         return false;
     }
 
-    lexer->mark_end(lexer);
+    mark_end(lexer);
 
-    unsigned col = lexer->get_column(lexer);
+    s->start_column = UNKNOWN_COLUMN;
+    s->advanced = 0;
+
+    // where the column that bullets and LIST_END compare with the list's
+    // indent is taken: the start of the scan, or past any blanks skipped below
+    uint32_t col_offset = 0;
 
     unsigned char indent = s->list_indents.size == 0
         ? 255 : *array_back(&s->list_indents);
@@ -394,7 +878,7 @@ bool tree_sitter_orgmode_external_scanner_scan(
     char fail = '\0'; // '\0' is "no fail yet"
 
     LOG("********");
-    LOG("col: %d; indent: %d; in_drawer: %c; lookahead: '%c'", col, indent, in_drawer, lexer->lookahead);
+    LOG("indent: %d; in_drawer: %c; lookahead: '%c'", indent, in_drawer, lexer->lookahead);
     LOG("%d items in markup stack", s->markup_stack.size);
     for (int i = 0; i < s->markup_stack.size; i++) {
         const enum TokenType ty = s->markup_stack.contents[i];
@@ -405,205 +889,212 @@ bool tree_sitter_orgmode_external_scanner_scan(
     TOKEN_TYPES
     #undef TOK
 
-    if (!fail && valid_symbols[NEWLINE] && lexer->lookahead == '\n') {
-        LOG("clearing markup stack, at end of line");
-        array_clear(&s->markup_stack);
-        lexer->advance(lexer, false);
-        lexer->mark_end(lexer);
-        lexer->result_symbol = NEWLINE;
-        return true;
-    }
+    // a raw body starts on the line after the block's name, so if the name has
+    // anything but blanks after it, those are the block's parameters
+    if (valid_symbols[RAW_BODY] && s->block_name_stack.size > 0 &&
+        is_raw_block(*array_back(&s->block_name_stack))) {
+        if (lexer->lookahead == '\n' && column(s, lexer) != 0) {
+            advance(s, lexer, true);
+            return scan_raw_body(s, lexer, valid_symbols);
+        }
 
-    if (!fail && valid_symbols[END_SECTION] && lexer->eof(lexer)) {
-        lexer->result_symbol = END_SECTION;
-        lexer->advance(lexer, false);
-        lexer->mark_end(lexer);
-        LOG("ending section due to EOF");
-        return true;
+        if (!lexer->eof(lexer) && column(s, lexer) == 0) {
+            return scan_raw_body(s, lexer, valid_symbols);
+        }
     }
 
-    if (!fail && valid_symbols[PATHREG] && !lexer->eof(lexer) && is_pathreg_char(lexer->lookahead)) {
-        LOG("trying pathreg");
-
-        lexer->advance(lexer, false);
-
-        unsigned n;
-        for (n = 1;; n++) {
-            if (lexer->eof(lexer)) break;
-
-            char ch = lexer->lookahead;
-            if (is_pathreg_char(ch)) {
-                lexer->advance(lexer, false);
-
-                if (ch == '\\' && (lexer->lookahead == '[' || lexer->lookahead == ']' || lexer->lookahead == '\\')) {
-                    lexer->advance(lexer, false);
-                }
-            } else {
-                break;
+    // the lookahead alone rules out nearly every token, so dispatch on it
+    // before trying anything that needs to advance
+    switch (lexer->lookahead) {
+        case '\n':
+            if (valid_symbols[NEWLINE]) {
+                LOG("clearing markup stack, at end of line");
+                clear_markup(s);
+                advance(s, lexer, false);
+                mark_end(lexer);
+                lexer->result_symbol = NEWLINE;
+                return true;
             }
-        }
-
-        LOG("got pathreg, len: %d", n);
-        lexer->mark_end(lexer);
-        lexer->result_symbol = PATHREG;
-        return true;
-    }
+            break;
 
-    if (!fail && in_drawer == PROPERTY_DRAWER && valid_symbols[PROPERTY_NAME] && lexer->lookahead == ':') {
-        LOG("looking for a property name");
+        case ':':
+            if (valid_symbols[PATHREG]) return scan_pathreg(s, lexer);
 
-        lexer->advance(lexer, false);
-        const char *name = scan_while(lexer, is_property_name_char);
-        if (name != NULL) {
-            if (lexer->lookahead == ':') {
-                lexer->advance(lexer, false);
+            if (in_drawer == PROPERTY_DRAWER && valid_symbols[PROPERTY_NAME]) {
+                LOG("looking for a property name");
 
-                LOG("got one: %s", name);
+                advance(s, lexer, false);
+                if (scan_name(s, lexer, CC_PROPERTY_NAME) > 0) {
+                    const char *name = s->scratch.contents;
+                    if (lexer->lookahead == ':') {
+                        advance(s, lexer, false);
+
+                        LOG("got one: %s", name);
+
+                        // a name can't be 'end'
+                        if (strcmp(name, "end") == 0) {
+                            if (valid_symbols[DRAWER_END]) {
+                                lexer->result_symbol = DRAWER_END;
+                                array_pop(&s->drawer_stack);
+                                mark_end(lexer);
+                                return true;
+                            } else {
+                                return false;
+                            }
+                        }
+
+                        mark_end(lexer);
+                        lexer->result_symbol = PROPERTY_NAME;
+                        LOG("returning property name");
 
-                // a name can't be 'end'
-                if (strcmp(name, "end") == 0) {
-                    if (valid_symbols[DRAWER_END]) {
-                        lexer->result_symbol = DRAWER_END;
-                        array_pop(&s->drawer_stack);
-                        lexer->mark_end(lexer);
                         return true;
                     } else {
-                        return false;
+                        mark_end(lexer);
+                        lexer->result_symbol = WORD;
+                        STAT(stats.word_fallbacks++);
+
+                        return true;
                     }
                 }
-
-                ts_free((void*) name);
-                lexer->mark_end(lexer);
-                lexer->result_symbol = PROPERTY_NAME;
-                LOG("returning property name");
-
-                return true;
-            } else {
-                ts_free((void*) name);
-                lexer->mark_end(lexer);
-                lexer->result_symbol = WORD;
-
-                return true;
             }
-        }
-    }
 
-    if (!fail && in_drawer != PROPERTY_DRAWER && valid_symbols[DRAWER_NAME] && lexer->lookahead == ':') {
-        lexer->advance(lexer, false);
-        const char *name = scan_while(lexer, is_name_char);
+            if (in_drawer != PROPERTY_DRAWER && valid_symbols[DRAWER_NAME]) {
+                advance(s, lexer, false);
 
-        if (name != NULL) {
-            if (lexer->lookahead == ':') {
-                lexer->advance(lexer, false);
-
-                // a name can't be 'end'
-                if (strcmp(name, "end") == 0) {
-                    if (valid_symbols[DRAWER_END]) {
-                        lexer->result_symbol = DRAWER_END;
-                        array_pop(&s->drawer_stack);
-                        lexer->mark_end(lexer);
+                if (scan_name(s, lexer, CC_NAME) > 0) {
+                    const char *name = s->scratch.contents;
+                    if (lexer->lookahead == ':') {
+                        advance(s, lexer, false);
+
+                        // a name can't be 'end'
+                        if (strcmp(name, "end") == 0) {
+                            if (valid_symbols[DRAWER_END]) {
+                                lexer->result_symbol = DRAWER_END;
+                                array_pop(&s->drawer_stack);
+                                mark_end(lexer);
+                                return true;
+                            } else {
+                                return false;
+                            }
+                        }
+
+                        DrawerType drawer_type = strcmp(name, "properties") == 0
+                            ? PROPERTY_DRAWER : NORMAL_DRAWER;
+                        array_push(&s->drawer_stack, drawer_type);
+
+                        lexer->result_symbol = DRAWER_NAME;
+                        mark_end(lexer);
                         return true;
                     } else {
-                        return false;
+                        LOG("defaulting drawer name to a WORD, as no ':' following");
+                        lexer->result_symbol = WORD;
+                        STAT(stats.word_fallbacks++);
+                        mark_end(lexer);
+                        return true;
                     }
                 }
+            }
 
-                DrawerType drawer_type = strcmp(name, "properties") == 0
-                    ? PROPERTY_DRAWER : NORMAL_DRAWER;
-                ts_free((void*) name);
-                array_push(&s->drawer_stack, drawer_type);
-
-                lexer->result_symbol = DRAWER_NAME;
-                lexer->mark_end(lexer);
-                return true;
-            } else {
-                LOG("defaulting drawer name to a WORD, as no ':' following");
-                lexer->result_symbol = WORD;
-                lexer->mark_end(lexer);
-                ts_free((void*) name);
-                return true;
+            // an empty name above leaves us one past the first ':', which can
+            // still start an :end:
+            if (valid_symbols[DRAWER_END] && in_drawer != NO_DRAWER && lexer->lookahead == ':') {
+                unsigned len = scan_literal(s, lexer, ":end:", true);
+                if (len+1 == sizeof(":end:")) {
+                    mark_end(lexer);
+                    lexer->result_symbol = DRAWER_END;
+                    array_pop(&s->drawer_stack);
+                    return true;
+                } else if (len > 0) {
+                    mark_end(lexer);
+                    lexer->result_symbol = WORD;
+                    STAT(stats.word_fallbacks++);
+                    LOG("giving a WORD instead of an DRAWER_END");
+                    return true;
+                }
             }
-        }
-    }
+            break;
+
+        case '\0':
+            if (lexer->eof(lexer)) {
+                if (valid_symbols[END_SECTION]) {
+                    lexer->result_symbol = END_SECTION;
+                    advance(s, lexer, false);
+                    mark_end(lexer);
+                    LOG("ending section due to EOF");
+                    return true;
+                }
+                break;
+            }
+            if (valid_symbols[PATHREG]) return scan_pathreg(s, lexer);
+            break;
 
-    if (!fail && valid_symbols[DRAWER_END] && in_drawer != NO_DRAWER) {
-        unsigned len = scan_literal(lexer, ":end:", true);
-        if (len+1 == sizeof(":end:")) {
-            lexer->mark_end(lexer);
-            lexer->result_symbol = DRAWER_END;
-            array_pop(&s->drawer_stack);
-            return true;
-        } else if (len > 0) {
-            lexer->mark_end(lexer);
-            lexer->result_symbol = WORD;
-            LOG("giving a WORD instead of an DRAWER_END");
-            return true;
-        }
+        default:
+            if (valid_symbols[PATHREG] && is_pathreg_char(lexer->lookahead)) {
+                return scan_pathreg(s, lexer);
+            }
+            break;
     }
 
     if (!fail && valid_symbols[BLOCK_BEGIN_NAME]) {
-        lexer->log(lexer, "looking for a BLOCK_BEGIN_NAME");
+        LOG("looking for a BLOCK_BEGIN_NAME");
 
-        const char *name = scan_while(lexer, not_whitespace);
-        if (name == NULL) return false;
+        unsigned len = scan_name(s, lexer, CC_NOT_WHITESPACE);
+        if (len == 0) return false;
 
-        LOG("got one: '%s'", name);
+        BlockName id = intern_block_name(s, s->scratch.contents, len);
+        LOG("got one: '%s' (id %d)", s->scratch.contents, id);
 
-        array_push(&s->block_name_stack, name);
+        array_push(&s->block_name_stack, id);
         LOG("pushed to array");
 
         lexer->result_symbol = BLOCK_BEGIN_NAME;
-        lexer->mark_end(lexer);
+        mark_end(lexer);
 
         return true;
     }
 
     if (!fail && valid_symbols[BLOCK_END_NAME]) {
-        lexer->log(lexer, "looking for a BLOCK_END_NAME");
+        LOG("looking for a BLOCK_END_NAME");
 
-        const char *name = scan_while(lexer, not_whitespace);
-        if (name == NULL) return false;
+        if (scan_name(s, lexer, CC_NOT_WHITESPACE) == 0) return false;
+        const char *name = s->scratch.contents;
 
         if (s->block_name_stack.size == 0) {
             LOG("got one, but nothing on the stack...");
-            ts_free((void*) name);
             return false;
         }
 
-        const char *top_name = array_pop(&s->block_name_stack);
-        LOG("top name: '%s'", top_name);
-        int compare = strncmp(name, top_name, NAME_MAX_LEN);
-        LOG("comparing '%s' with '%s': %d", name, top_name, compare);
-
-        ts_free((void*) name);
+        // names are interned once, so only the innermost block's can match
+        const char *top = block_name_str(s, *array_back(&s->block_name_stack));
+        LOG("comparing '%s' with '%s'", name, top);
 
-        if (compare != 0) {
-            // push it back again; we're just a word
-            array_push(&s->block_name_stack, top_name);
+        if (!block_names_match(name, top)) {
+            // leave it on the stack; we're just a word
             lexer->result_symbol = WORD;
+            STAT(stats.word_fallbacks++);
         } else {
-            ts_free((void*) top_name);
+            array_pop(&s->block_name_stack);
             lexer->result_symbol = BLOCK_END_NAME;
         }
 
-        lexer->mark_end(lexer);
+        mark_end(lexer);
 
         return true;
     }
 
     if (!fail && lexer->lookahead == '#') {
-        lexer->advance(lexer, false);
+        advance(s, lexer, false);
 
         if (lexer->lookahead == '+') {
             // looking for a #+ pattern, e.g. #+begin_, or a keyword #+foo:
-            lexer->advance(lexer, false);
-            char ch = lexer->lookahead;
+            advance(s, lexer, false);
+            int32_t ch = lexer->lookahead;
 
             if (!fail && valid_symbols[BLOCK_END_MARKER]) {
-                unsigned len = scan_literal(lexer, "end_", true);
+                unsigned len = scan_literal(s, lexer, "end_", true);
                 if (len+1 == sizeof("end_")) {
                     lexer->result_symbol = BLOCK_END_MARKER;
-                    lexer->mark_end(lexer);
+                    mark_end(lexer);
                     return true;
                 } else if (len > 0) {
                     fail = '#';
@@ -611,10 +1102,10 @@ bool tree_sitter_orgmode_external_scanner_scan(
             }
 
             if (!fail && valid_symbols[BLOCK_BEGIN_MARKER]) {
-                unsigned len = scan_literal(lexer, "begin_", true);
+                unsigned len = scan_literal(s, lexer, "begin_", true);
                 if (len+1 == sizeof("begin_")) {
                     lexer->result_symbol = BLOCK_BEGIN_MARKER;
-                    lexer->mark_end(lexer);
+                    mark_end(lexer);
                     return true;
                 } else if (len > 0) {
                     fail = '#';
@@ -622,25 +1113,26 @@ bool tree_sitter_orgmode_external_scanner_scan(
             }
 
             if (valid_symbols[KEYWORD_KEY]) {
-                unsigned len = skip_while(lexer, is_kw_char, false);
+                unsigned len = skip_while(s, lexer, CC_KW, false);
                 if (len > 0 || is_kw_char(ch)) {
                     if (lexer->lookahead == ':') {
-                        lexer->advance(lexer, false);
+                        advance(s, lexer, false);
                         lexer->result_symbol = KEYWORD_KEY;
-                        lexer->mark_end(lexer);
+                        mark_end(lexer);
                         return true;
                     } else {
                         fail = '#';
                     }
                 }
             }
-        } else if (col == 0 && is_whitespace(lexer->lookahead) && valid_symbols[COMMENT_LINE]) {
+        } else if (is_whitespace(lexer->lookahead) && valid_symbols[COMMENT_LINE] && column_at(s, lexer, 0) == 0) {
             // aha, a comment!
-            while (!lexer->eof(lexer) && is_comment_char(lexer->lookahead)) {
-                lexer->advance(lexer, false);
+            while (is_comment_char(lexer->lookahead)) {
+                if (lexer->lookahead == '\0' && lexer->eof(lexer)) break;
+                advance(s, lexer, false);
             }
             lexer->result_symbol = COMMENT_LINE;
-            lexer->mark_end(lexer);
+            mark_end(lexer);
             return true;
         }
 
@@ -650,30 +1142,30 @@ bool tree_sitter_orgmode_external_scanner_scan(
     }
 
     // skip past any horizontal whitespace now
-    while (!lexer->eof(lexer) && (lexer->lookahead == ' ' || lexer->lookahead == '\t')) {
-        lexer->advance(lexer, true);
-        col = lexer->get_column(lexer);
+    while (has_class(lexer->lookahead, CC_BLANK)) {
+        advance(s, lexer, true);
+        col_offset = s->advanced;
     }
 
     if (!fail && valid_symbols[BULLET] || valid_symbols[LIST_START]) {
-        lexer->mark_end(lexer);
+        mark_end(lexer);
 
-        Bullet b = scan_bullet(lexer);
+        Bullet b = scan_bullet(s, lexer);
         LOG("tried to scan a bullet; got: '%c'", b);
 
         if (b != NO_BULLET) {
+            unsigned col = column_at(s, lexer, col_offset);
             LOG("got bullet '%c'", b);
             // got a bullet
             if (valid_symbols[LIST_START] && (indent == 255 || col > indent)) {
                 lexer->result_symbol = LIST_START;
                 array_push(&s->list_indents, col);
-                LOG("pushing list start for bullet: %c (indent %d)",
-                    b, lexer->get_column(lexer));
+                LOG("pushing list start for bullet: %c (indent %d)", b, col);
                 return true;
             }
 
             if (valid_symbols[BULLET] && col == indent) {
-                lexer->mark_end(lexer);
+                mark_end(lexer);
                 lexer->result_symbol = BULLET;
                 LOG("returning bullet: %c", b);
                 return true;
@@ -683,25 +1175,25 @@ bool tree_sitter_orgmode_external_scanner_scan(
         LOG("... no bullet found");
     }
 
-    if (scan_markup_end(s, lexer, valid_symbols, &fail)) {
-        return true;
-    }
+    if (has_class(lexer->lookahead, CC_MARKUP)) {
+        if (scan_markup_end(s, lexer, valid_symbols, &fail)) {
+            return true;
+        }
 
-    if (scan_markup_start(s, lexer, valid_symbols, &fail)) {
-        return true;
+        if (scan_markup_start(s, lexer, valid_symbols, &fail)) {
+            return true;
+        }
     }
 
-    if (!fail && valid_symbols[STARS] && lexer->get_column(lexer) == 0 && lexer->lookahead == '*') {
+    if (!fail && valid_symbols[STARS] && lexer->lookahead == '*' && column(s, lexer) == 0) {
         return scan_stars(s, lexer, valid_symbols, 0);
     }
 
-    if (fail == '*' && valid_symbols[STARS] && lexer->get_column(lexer) == 1) {
+    if (fail == '*' && valid_symbols[STARS] && column(s, lexer) == 1) {
         return scan_stars(s, lexer, valid_symbols, 1);
     }
 
-    bool can_end_list = lexer->eof(lexer) || (indent != 255 && col <= indent);
-    LOG("could we end a list (col: %d, indent: %d)? %s", col, indent, can_end_list ? "yes" : "no");
-    if (!fail && valid_symbols[LIST_END] && can_end_list) {
+    if (!fail && valid_symbols[LIST_END] && ((indent != 255 && column_at(s, lexer, col_offset) <= indent) || lexer->eof(lexer))) {
         lexer->result_symbol = LIST_END;
         array_pop(&s->list_indents);
         LOG("ending list!");
@@ -719,12 +1211,14 @@ bool tree_sitter_orgmode_external_scanner_scan(
             LOG("attempting a word. (from fresh; no earlier fails)");
         }
 
-        while (!lexer->eof(lexer) && is_word_char(s, lexer->lookahead)) {
-            lexer->advance(lexer, false);
+        // '\0' is never a word char, so this stops at the end too
+        while (is_word_char(s, lexer->lookahead)) {
+            advance(s, lexer, false);
         }
 
         lexer->result_symbol = WORD;
-        lexer->mark_end(lexer);
+        STAT(if (fail != '\0') stats.word_fallbacks++);
+        mark_end(lexer);
         LOG("got word!");
 
         return true;
@@ -735,8 +1229,24 @@ bool tree_sitter_orgmode_external_scanner_scan(
     return false;
 }
 
+bool tree_sitter_orgmode_external_scanner_scan(
+    void *payload,
+    TSLexer *lexer,
+    const bool *valid_symbols
+) {
+#ifdef ORGMODE_SCANNER_STATS
+    stats_begin_scan(valid_symbols);
+    bool found = scan((Scanner*) payload, lexer, valid_symbols);
+    stats_end_scan(lexer, found);
+    return found;
+#else
+    return scan((Scanner*) payload, lexer, valid_symbols);
+#endif
+}
+
 void * tree_sitter_orgmode_external_scanner_create() {
     Scanner *s = (Scanner*) ts_calloc(1, sizeof(Scanner));
+    array_reserve(&s->scratch, NAME_MAX_LEN);
 
     return s;
 }
@@ -744,58 +1254,234 @@ void * tree_sitter_orgmode_external_scanner_create() {
 void tree_sitter_orgmode_external_scanner_destroy(void *payload) {
     Scanner *s = (Scanner*) payload;
 
-    #undef ARRAY_STR
-    #define ARRAY_STR(name) \
-    for (unsigned i = 0; i < s->name.size; i++) { \
-        const char* val = s->name.contents[i]; \
-        ts_free((void*) val); \
-    } \
-    array_delete(&s->name);
-
     #define ARRAY(name, _) array_delete(&s->name);
-
     ARRAYS
     #undef ARRAY
-    #undef ARRAY_STR
-    #define ARRAY_STR(name) ARRAY(name, const char *)
 
+    array_delete(&s->scratch);
+    array_delete(&s->custom_block_names);
+    array_delete(&s->custom_block_name_offsets);
     ts_free(s);
 }
 
+// the serialized state is empty when every stack is, which is the case for
+// most tokens outside of lists, drawers and blocks. otherwise, it starts with
+// a header byte holding STATE_VERSION in its top bits, and a flag for each
+// stack which isn't empty. each of those stacks follows, outermost entry
+// first, as a varint count and then its entries:
+//
+//  - section_level, list_indents: varint deltas from the previous entry
+//  - drawer_stack: 1 bit per drawer, set for property drawers
+//  - markup_stack: 3 bits per entry, the index into markup_begins
+//  - block_name_stack: one byte per id. custom names are written as
+//    NO_BLOCK_NAME followed by the NUL-terminated name.
+//
+// if a stack doesn't fit in what's left of the buffer, its outermost entries
+// are dropped until it does. that only happens for absurdly deep nesting or
+// long block names, and the innermost entries are the ones that matter for
+// the tokens coming up next.
+#define STATE_VERSION 1
+#define STATE_VERSION_SHIFT 5
+
+enum {
+    HAS_SECTION_LEVEL = 1 << 0,
+    HAS_LIST_INDENTS = 1 << 1,
+    HAS_DRAWER_STACK = 1 << 2,
+    HAS_MARKUP_STACK = 1 << 3,
+    HAS_BLOCK_NAME_STACK = 1 << 4,
+};
+
+#define MARKUP_BITS 3
+
+typedef struct {
+    char *buffer;
+    unsigned size;
+    unsigned char bits; // pending bits, not yet written
+    unsigned bit_count;
+} Writer;
+
+typedef struct {
+    const char *buffer;
+    unsigned length;
+    unsigned n;
+    unsigned char bits;
+    unsigned bit_count;
+    bool error;
+} Reader;
+
+static inline bool write_byte(Writer *w, unsigned char byte) {
+    if (w->size >= TREE_SITTER_SERIALIZATION_BUFFER_SIZE) return false;
+    w->buffer[w->size++] = byte;
+    return true;
+}
+
+static bool write_varint(Writer *w, uint32_t value) {
+    while (value >= 0x80) {
+        if (!write_byte(w, (value & 0x7f) | 0x80)) return false;
+        value >>= 7;
+    }
+    return write_byte(w, value);
+}
+
+static bool write_bits(Writer *w, unsigned value, unsigned width) {
+    for (unsigned i = 0; i < width; i++) {
+        w->bits |= ((value >> i) & 1) << w->bit_count;
+        if (++w->bit_count == 8) {
+            if (!write_byte(w, w->bits)) return false;
+            w->bits = 0;
+            w->bit_count = 0;
+        }
+    }
+    return true;
+}
+
+static bool flush_bits(Writer *w) {
+    if (w->bit_count == 0) return true;
+    unsigned char bits = w->bits;
+    w->bits = 0;
+    w->bit_count = 0;
+    return write_byte(w, bits);
+}
+
+static inline unsigned char read_byte(Reader *r) {
+    if (r->n >= r->length) {
+        r->error = true;
+        return 0;
+    }
+    return r->buffer[r->n++];
+}
+
+static uint32_t read_varint(Reader *r) {
+    uint32_t value = 0;
+    for (unsigned shift = 0; shift < 32 && !r->error; shift += 7) {
+        unsigned char byte = read_byte(r);
+        value |= (uint32_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    r->error = true;
+    return 0;
+}
+
+static unsigned read_bits(Reader *r, unsigned width) {
+    unsigned value = 0;
+    for (unsigned i = 0; i < width; i++) {
+        if (r->bit_count == 0) {
+            r->bits = read_byte(r);
+            r->bit_count = 8;
+        }
+        value |= (r->bits & 1) << i;
+        r->bits >>= 1;
+        r->bit_count--;
+    }
+    return value;
+}
+
+// zig-zag encodes a delta, so that small negative ones stay small too
+static inline uint32_t delta_to_varint(int delta) {
+    return ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+}
+
+static inline int varint_to_delta(uint32_t value) {
+    return (int) (value >> 1) ^ -(int) (value & 1);
+}
+
+static bool encode_deltas(Writer *w, const unsigned char *items, unsigned count) {
+    if (!write_varint(w, count)) return false;
+
+    int prev = 0;
+    for (unsigned i = 0; i < count; i++) {
+        if (!write_varint(w, delta_to_varint(items[i] - prev))) return false;
+        prev = items[i];
+    }
+    return true;
+}
+
+static bool encode_drawers(Writer *w, const DrawerType *items, unsigned count) {
+    if (!write_varint(w, count)) return false;
+
+    for (unsigned i = 0; i < count; i++) {
+        if (!write_bits(w, items[i] == PROPERTY_DRAWER, 1)) return false;
+    }
+    return flush_bits(w);
+}
+
+static bool encode_markup(Writer *w, const enum TokenType *items, unsigned count) {
+    if (!write_varint(w, count)) return false;
+
+    for (unsigned i = 0; i < count; i++) {
+        if (!write_bits(w, markup_index[items[i]], MARKUP_BITS)) return false;
+    }
+    return flush_bits(w);
+}
+
+static bool encode_block_names(const Scanner *s, Writer *w, const BlockName *items, unsigned count) {
+    if (!write_varint(w, count)) return false;
+
+    for (unsigned i = 0; i < count; i++) {
+        BlockName id = items[i];
+        if (id < FIRST_CUSTOM_BLOCK_NAME) {
+            if (!write_byte(w, id)) return false;
+            continue;
+        }
+
+        // custom ids are only meaningful to this scanner, so write the name
+        const char *name = block_name_str(s, id);
+        if (!write_byte(w, NO_BLOCK_NAME)) return false;
+        do {
+            if (!write_byte(w, *name)) return false;
+        } while (*name++ != '\0');
+    }
+    return true;
+}
+
 unsigned tree_sitter_orgmode_external_scanner_serialize(
     void *payload,
     char *buffer
 ) {
     Scanner *s = (Scanner*) payload;
-    unsigned n = 0;
 
-    PRINT("SERIALIZING... size=%d\n", s->block_name_stack.size);
+    bool empty = true;
+    #define ARRAY(name, _) empty = empty && s->name.size == 0;
+    ARRAYS
+    #undef ARRAY
 
-    #define ARRAY(name, type) \
-    buffer[n++] = s->name.size; \
-    for (unsigned i = 0; i < s->name.size; i++) { \
-        buffer[n++] = s->name.contents[i]; \
+    STAT(stats.serializations++);
+    if (empty) return 0;
+
+    Writer w = {.buffer = buffer, .size = 1};
+    unsigned char header = STATE_VERSION << STATE_VERSION_SHIFT;
+
+    // the arguments before the items are the encoder's own, the writer last
+    #define STACK_WITH(name, flag, encode, ...) \
+    for (uint32_t from = 0; from < s->name.size; from++) { \
+        unsigned mark = w.size; \
+        if (encode(__VA_ARGS__, s->name.contents + from, s->name.size - from)) { \
+            header |= flag; \
+            break; \
+        } \
+        LOG("state too big; dropping the outermost entry of " #name); \
+        w.size = mark; \
+        w.bits = 0; \
+        w.bit_count = 0; \
     }
 
-    #undef ARRAY_STR
-    #define ARRAY_STR(name) \
-    buffer[n++] = s->name.size; \
-    for (unsigned i = 0; i < s->name.size; i++) { \
-        const char* val = s->name.contents[i]; \
-        unsigned len = strlen(val); \
-        strncpy(buffer + n, val, len); \
-        buffer[n + len] = '\0'; \
-        n += len + 1; \
-    }
+    #define STACK(name, flag, encode) STACK_WITH(name, flag, encode, &w)
 
-    ARRAYS
-    #undef ARRAY
-    #undef ARRAY_STR
-    #define ARRAY_STR(name) ARRAY(name, const char *)
+    STACK(section_level, HAS_SECTION_LEVEL, encode_deltas)
+    STACK(list_indents, HAS_LIST_INDENTS, encode_deltas)
+    STACK(drawer_stack, HAS_DRAWER_STACK, encode_drawers)
+    STACK(markup_stack, HAS_MARKUP_STACK, encode_markup)
+    // custom names are written out, so these need the scanner's table
+    STACK_WITH(block_name_stack, HAS_BLOCK_NAME_STACK, encode_block_names, s, &w)
+    #undef STACK
+    #undef STACK_WITH
 
-    PRINT("SERIALIZED: %d bytes\n  to buffer: '%s'\n", n, buffer);
+    buffer[0] = header;
 
-    return n;
+    PRINT("SERIALIZED: %d bytes\n", w.size);
+    STAT(stats.serialized_bytes += w.size);
+
+    return w.size;
 }
 
 void tree_sitter_orgmode_external_scanner_deserialize(
@@ -804,39 +1490,107 @@ void tree_sitter_orgmode_external_scanner_deserialize(
     unsigned length
 ) {
     Scanner *s = (Scanner*) payload;
-    unsigned n = 0;
 
-    PRINT("DESERIALIZING: %d bytes: '%s'\n", length, buffer);
+    PRINT("DESERIALIZING: %d bytes\n", length);
+    STAT(stats.deserializations++; stats.deserialized_bytes += length);
 
-    #define ARRAY(name, _) array_init(&s->name);
+    // this runs for almost every token, so the stacks keep their capacity
+    // rather than being reallocated each time
+    #define ARRAY(name, _) array_clear(&s->name);
     ARRAYS
     #undef ARRAY
 
-    if (length > 0) {
-        unsigned char size;
+    clear_markup(s);
 
-        #define ARRAY(name, type) \
-        size = buffer[n++]; \
-        for (unsigned i = 0; i < size; i++) { \
-            array_push(&s->name, buffer[n++]); \
-        }
+    // the serialized state names every custom block it needs, so anything
+    // interned before now is stale
+    array_clear(&s->custom_block_names);
+    array_clear(&s->custom_block_name_offsets);
+
+    if (length == 0) return;
 
-        #undef ARRAY_STR
-        #define ARRAY_STR(name) \
-        size = buffer[n++]; \
-        for (unsigned i = 0; i < size; i++) { \
-            unsigned len = strlen(buffer + n); \
-            char *val = ts_calloc(1, sizeof(char) * (len + 1)); \
-            strncpy(val, buffer + n, len); \
-            array_push(&s->name, val); \
-            n += strlen(buffer + n) + 1; \
+    Reader r = {.buffer = buffer, .length = length};
+    unsigned char header = read_byte(&r);
+
+    if (header >> STATE_VERSION_SHIFT != STATE_VERSION) {
+        // not ours to read. the best we can do is to start from nothing.
+        PRINT("DESERIALIZE: unknown state version %d\n", header >> STATE_VERSION_SHIFT);
+        return;
+    }
+
+    uint32_t count;
+
+    // each stack is reserved once, up front, and then filled in place. every
+    // entry takes at least one bit, which bounds the count a malformed state
+    // could make us reserve.
+    #define DECODE(name, flag, ...) \
+    if (header & flag) { \
+        count = read_varint(&r); \
+        if (count > (length - r.n) * 8) r.error = true; \
+        else array_reserve(&s->name, count); \
+        for (uint32_t i = 0; i < count && !r.error; i++) { \
+            __VA_ARGS__ \
+        } \
+        r.bit_count = 0; \
+    }
+
+    #define PUT(name, value) (s->name.contents[s->name.size++] = (value))
+
+    int level = 0;
+    DECODE(section_level, HAS_SECTION_LEVEL, {
+        level += varint_to_delta(read_varint(&r));
+        PUT(section_level, level);
+    })
+
+    int indent = 0;
+    DECODE(list_indents, HAS_LIST_INDENTS, {
+        indent += varint_to_delta(read_varint(&r));
+        PUT(list_indents, indent);
+    })
+
+    DECODE(drawer_stack, HAS_DRAWER_STACK, {
+        PUT(drawer_stack, read_bits(&r, 1) ? PROPERTY_DRAWER : NORMAL_DRAWER);
+    })
+
+    DECODE(markup_stack, HAS_MARKUP_STACK, {
+        unsigned index = read_bits(&r, MARKUP_BITS);
+        if (index >= NUM_MARKUP_TOKS) {
+            r.error = true;
+            break;
         }
+        PUT(markup_stack, markup_begins[index]);
+        s->open_markup_counts[index]++;
+        s->open_markup |= 1 << index;
+    })
+
+    DECODE(block_name_stack, HAS_BLOCK_NAME_STACK, {
+        BlockName id = read_byte(&r);
+        if (id == NO_BLOCK_NAME) {
+            const char *name = buffer + r.n;
+            const char *end = memchr(name, '\0', length - r.n);
+            if (end == NULL) {
+                r.error = true;
+                break;
+            }
+            id = intern_block_name(s, name, end - name);
+            r.n += end - name + 1;
+        } else if (id >= FIRST_CUSTOM_BLOCK_NAME) {
+            r.error = true;
+            break;
+        }
+        PUT(block_name_stack, id);
+    })
+
+    #undef PUT
+    #undef DECODE
 
+    if (r.error) {
+        PRINT("DESERIALIZE: malformed state; starting from nothing\n");
+        #define ARRAY(name, _) array_clear(&s->name);
         ARRAYS
         #undef ARRAY
-        #undef ARRAY_STR
-        #define ARRAY_STR(name) ARRAY(name, const char *)
+        clear_markup(s);
     }
 
-    PRINT("DESERIALIZED finished: n reached %d\n", n);
+    PRINT("DESERIALIZED finished: n reached %d\n", r.n);
 }
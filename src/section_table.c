@@ -0,0 +1,65 @@
+// Storage for the section table, TSOrgmodeSections. Filling it walks a tree,
+// which needs the tree-sitter runtime, so that's in
+// tree-sitter-orgmode-runtime.h: tree_sitter_orgmode_sections and
+// tree_sitter_orgmode_sections_update.
+//
+// The arrays reserve makes are carved out of one allocation, the 32 bit ones
+// first so every array is aligned.
+
+#include "tree_sitter/alloc.h"
+
+#include "../bindings/c/tree_sitter/tree-sitter-orgmode.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// the 32 bit arrays, then the 8 bit ones
+#define WIDE_ARRAYS 6
+#define NARROW_ARRAYS 2
+
+bool tree_sitter_orgmode_sections_reserve(TSOrgmodeSections *sections, uint32_t capacity) {
+    if (capacity <= sections->capacity) return true;
+    if (capacity < 64) capacity = 64;
+
+    size_t n = capacity;
+    char *storage = ts_malloc(n * (WIDE_ARRAYS * sizeof(uint32_t) + NARROW_ARRAYS * sizeof(uint8_t)));
+    if (storage == NULL) return false;
+
+    uint32_t *wide = (uint32_t *) storage;
+    uint8_t *narrow = (uint8_t *) (wide + WIDE_ARRAYS * n);
+    TSOrgmodeSections grown = {
+        .count = sections->count,
+        .capacity = capacity,
+        .levels = wide,
+        .start_bytes = wide + n,
+        .end_bytes = wide + 2 * n,
+        .title_starts = wide + 3 * n,
+        .title_ends = wide + 4 * n,
+        .parents = wide + 5 * n,
+        .todos = narrow,
+        .priorities = narrow + n,
+        .storage = storage,
+    };
+
+    uint32_t kept = sections->count < sections->capacity ? sections->count : sections->capacity;
+    if (kept > 0) {
+        memcpy(grown.levels, sections->levels, kept * sizeof(uint32_t));
+        memcpy(grown.start_bytes, sections->start_bytes, kept * sizeof(uint32_t));
+        memcpy(grown.end_bytes, sections->end_bytes, kept * sizeof(uint32_t));
+        memcpy(grown.title_starts, sections->title_starts, kept * sizeof(uint32_t));
+        memcpy(grown.title_ends, sections->title_ends, kept * sizeof(uint32_t));
+        memcpy(grown.parents, sections->parents, kept * sizeof(uint32_t));
+        memcpy(grown.todos, sections->todos, kept);
+        memcpy(grown.priorities, sections->priorities, kept);
+    }
+
+    ts_free(sections->storage);
+    *sections = grown;
+    return true;
+}
+
+void tree_sitter_orgmode_sections_delete(TSOrgmodeSections *sections) {
+    ts_free(sections->storage);
+    memset(sections, 0, sizeof(*sections));
+}
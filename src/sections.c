@@ -0,0 +1,111 @@
+// Included ranges for parsing part of a document: a skeleton of its headings
+// alone, or one section at a time. They're worked out from the outline (see
+// outline.c), so nothing but the parts asked for is ever parsed.
+//
+// Once every block and drawer before a section has been closed, the
+// scanner's state at the start of it depends only on the levels of the
+// sections it's nested in. Parsing their heading lines just before it puts
+// the scanner in that state, and the section comes out as it would in a full
+// parse. One left open stays on the scanner's stacks through every heading
+// after it, so a section after that is parsed with everything before it.
+
+#include "../bindings/c/tree_sitter/tree-sitter-orgmode.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+static inline bool is_heading(const TSOrgmodeOutlineEntry *entry) {
+    return entry->kind == TS_ORGMODE_OUTLINE_HEADING;
+}
+
+// a heading's line, including its newline
+static TSOrgmodeLineRange heading_line(const TSOrgmodeOutlineEntry *entry) {
+    return (TSOrgmodeLineRange) {
+        .start_byte = entry->start_byte,
+        .start_row = entry->start_row,
+        .end_byte = entry->end_byte + 1,
+        .end_row = entry->end_row + 1,
+    };
+}
+
+uint32_t tree_sitter_orgmode_section_ranges(
+    const TSOrgmodeOutline *outline,
+    uint32_t heading,
+    TSOrgmodeLineRange *ranges,
+    uint32_t capacity
+) {
+    if (heading >= outline->count || !is_heading(&outline->entries[heading])) return 0;
+    const TSOrgmodeOutlineEntry *section = &outline->entries[heading];
+
+    bool left_open = false;
+    for (uint32_t i = 0; i < heading && !left_open; i++) {
+        left_open = !is_heading(&outline->entries[i]) && !outline->entries[i].closed;
+    }
+
+    // the sections it's in are the headings before it with a lower level than
+    // any between them and it, found nearest first
+    uint32_t ancestors = 0;
+    uint32_t level = section->level;
+    for (uint32_t i = heading; i-- > 0 && level > 1;) {
+        if (is_heading(&outline->entries[i]) && outline->entries[i].level < level) {
+            level = outline->entries[i].level;
+            ancestors++;
+        }
+    }
+
+    if (left_open) ancestors = 0;
+    uint32_t count = ancestors + 1;
+    if (capacity < count) return count;
+
+    level = section->level;
+    for (uint32_t i = heading, n = ancestors; n > 0;) {
+        const TSOrgmodeOutlineEntry *entry = &outline->entries[--i];
+        if (is_heading(entry) && entry->level < level) {
+            level = entry->level;
+            ranges[--n] = heading_line(entry);
+        }
+    }
+
+    // it runs up to the next heading which would end it, or to the end
+    TSOrgmodeLineRange *range = &ranges[ancestors];
+    range->start_byte = left_open ? 0 : section->start_byte;
+    range->start_row = left_open ? 0 : section->start_row;
+    range->end_byte = UINT32_MAX;
+    range->end_row = UINT32_MAX;
+    for (uint32_t i = heading + 1; i < outline->count; i++) {
+        const TSOrgmodeOutlineEntry *entry = &outline->entries[i];
+        if (is_heading(entry) && entry->level <= section->level) {
+            range->end_byte = entry->start_byte;
+            range->end_row = entry->start_row;
+            break;
+        }
+    }
+
+    return count;
+}
+
+uint32_t tree_sitter_orgmode_heading_ranges(
+    const TSOrgmodeOutline *outline,
+    TSOrgmodeLineRange *ranges,
+    uint32_t capacity
+) {
+    uint32_t count = 0;
+    uint32_t previous_end = UINT32_MAX;
+    for (uint32_t i = 0; i < outline->count; i++) {
+        if (!is_heading(&outline->entries[i])) continue;
+        TSOrgmodeLineRange line = heading_line(&outline->entries[i]);
+
+        // headings on consecutive lines share a range
+        if (count > 0 && line.start_byte == previous_end) {
+            if (count <= capacity) {
+                ranges[count - 1].end_byte = line.end_byte;
+                ranges[count - 1].end_row = line.end_row;
+            }
+        } else {
+            if (count < capacity) ranges[count] = line;
+            count++;
+        }
+        previous_end = line.end_byte;
+    }
+    return count;
+}